@@ -0,0 +1,3 @@
+// Uniform blocks shared by every scene shader, matching ubo.h.
+layout (std140) uniform Frame { mat4 view; mat4 proj; mat4 view_proj; mat4 inv_view_proj; vec4 cam_pos; } frame;
+layout (std140) uniform Draw { mat4 model; vec4 color; } draw;
@@ -0,0 +1,27 @@
+#version 330 core
+out vec4 FragColor;
+#include "common.glsl"
+#include "lighting.glsl"
+#include "gbuffer.glsl"
+uniform sampler2D gbuffer_albedo;
+uniform sampler2D gbuffer_normal;
+uniform sampler2D gbuffer_depth;
+void main() {
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+	float z = texelFetch(gbuffer_depth, texel, 0).r;
+	if (z == 1.0f) {
+		FragColor = vec4(0.0f); // Nothing drawn here.
+		return;
+	}
+	vec4 albedo = texelFetch(gbuffer_albedo, texel, 0);
+	vec3 normal = decode_normal(texelFetch(gbuffer_normal, texel, 0).rg);
+
+	// Rebuild the position from depth instead of storing it.
+	vec4 ndc = vec4(gl_FragCoord.xy / clusters.screen.xy, z, 1.0f) * 2.0f - 1.0f;
+	vec4 world = frame.inv_view_proj * ndc;
+	vec3 world_pos = world.xyz / world.w;
+	float depth = -(frame.view * vec4(world_pos, 1.0f)).z;
+
+	vec3 color = shade_clustered(gl_FragCoord.xy, depth, world_pos, normal, albedo.rgb, albedo.a);
+	FragColor = vec4(apply_fog(color, depth), 1.0f);
+}
@@ -0,0 +1,10 @@
+#version 330 core
+in vec3 world_pos;
+layout (location = 0) out vec4 albedo;
+layout (location = 1) out vec2 normal;
+#include "common.glsl"
+#include "gbuffer.glsl"
+void main() {
+	albedo = draw.color;
+	normal = encode_normal(normalize(cross(dFdx(world_pos), dFdy(world_pos))));
+}
@@ -0,0 +1,23 @@
+// G-buffer layout, see gbuffer.h. 8 bytes per pixel plus depth:
+// 0: RGBA8 albedo, specular strength in alpha.
+// 1: RG16 octahedral normal.
+
+vec2 sign_not_zero(vec2 v) {
+	return vec2(v.x >= 0.0f ? 1.0f : -1.0f, v.y >= 0.0f ? 1.0f : -1.0f);
+}
+
+// Unit vector to [0, 1]^2, folding the lower hemisphere of the octahedron out.
+vec2 encode_normal(vec3 n) {
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 e = n.z >= 0.0f ? n.xy : (1.0f - abs(n.yx)) * sign_not_zero(n.xy);
+	return e * 0.5f + 0.5f;
+}
+
+vec3 decode_normal(vec2 e) {
+	e = e * 2.0f - 1.0f;
+	vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+	if (n.z < 0.0f) {
+		n.xy = (1.0f - abs(n.yx)) * sign_not_zero(n.xy);
+	}
+	return normalize(n);
+}
@@ -0,0 +1,70 @@
+#include "common.glsl"
+
+// Clustered point lights, binned on the CPU by cluster.c.
+layout (std140) uniform Clusters { vec4 grid; vec4 slicing; vec4 screen; } clusters;
+uniform samplerBuffer light_data;    // Position and radius, then color, per light.
+uniform usamplerBuffer cluster_grid;  // Offset and count of each cluster's lights.
+uniform usamplerBuffer light_indices;
+
+// Sun with cascaded shadow maps, rendered by shadow.c.
+layout (std140) uniform Shadows { mat4 cascades[4]; vec4 splits; vec4 texel_size; vec4 light_dir; vec4 light_color; } shadows;
+uniform sampler2DArrayShadow shadow_map;
+
+const vec3 AMBIENT = vec3(0.1f);
+const float SHININESS = 32.0f;
+const float SHADOW_NORMAL_OFFSET = 1.5f; // In texels of the cascade.
+
+// Fraction of the sun reaching `world_pos` at view depth `depth`. The position is
+// pushed out along the normal by a texel or so against acne.
+float sun_visibility(vec3 world_pos, vec3 normal, float depth) {
+	int cascade = int(dot(vec4(greaterThan(vec4(depth), shadows.splits)), vec4(1.0f)));
+	if (cascade > 3) {
+		return 1.0f; // Past the last cascade.
+	}
+	vec3 offset = normal * shadows.texel_size[cascade] * SHADOW_NORMAL_OFFSET;
+	vec4 coord = shadows.cascades[cascade] * vec4(world_pos + offset, 1.0f);
+	return texture(shadow_map, vec4(coord.xy, float(cascade), coord.z));
+}
+
+// Light a fragment at `frag_coord` (gl_FragCoord.xy) and view depth `depth`
+// by the sun and the point lights with Blinn-Phong, `specular` scaling the highlights.
+vec3 shade_clustered(vec2 frag_coord, float depth, vec3 world_pos, vec3 normal, vec3 albedo, float specular) {
+	ivec3 cell = ivec3(vec3(frag_coord / clusters.screen.xy * clusters.grid.xy, log(depth) * clusters.slicing.x + clusters.slicing.y));
+	cell = clamp(cell, ivec3(0), ivec3(clusters.grid.xyz) - 1);
+	int cluster = cell.x + int(clusters.grid.x) * (cell.y + int(clusters.grid.y) * cell.z);
+	uvec2 range = texelFetch(cluster_grid, cluster).xy;
+
+	vec3 to_eye = normalize(frame.cam_pos.xyz - world_pos);
+	vec3 color = albedo * AMBIENT;
+	float sun = max(dot(normal, shadows.light_dir.xyz), 0.0f);
+	if (sun > 0.0f) {
+		float highlight = pow(max(dot(normal, normalize(shadows.light_dir.xyz + to_eye)), 0.0f), SHININESS);
+		color += (albedo * sun + specular * highlight) * shadows.light_color.rgb * sun_visibility(world_pos, normal, depth);
+	}
+	for (uint i = 0u; i < range.y; i++) {
+		int light = int(texelFetch(light_indices, int(range.x + i)).x);
+		vec4 position = texelFetch(light_data, light * 2);
+		vec3 light_color = texelFetch(light_data, light * 2 + 1).rgb;
+		vec3 to_light = position.xyz - world_pos;
+		float distance = length(to_light);
+		to_light /= distance;
+		float falloff = clamp(1.0f - distance / position.w, 0.0f, 1.0f);
+		float diffuse = max(dot(normal, to_light), 0.0f);
+		float highlight = diffuse > 0.0f ? pow(max(dot(normal, normalize(to_light + to_eye)), 0.0f), SHININESS) : 0.0f;
+		color += (albedo * diffuse + specular * highlight) * light_color * falloff * falloff;
+	}
+	return color;
+}
+
+#ifdef FOG
+const float FOG_DISTANCE = 60.0f;
+#endif
+
+// Darken with view depth in the FOG permutation.
+vec3 apply_fog(vec3 color, float depth) {
+#ifdef FOG
+	return color * (1.0f - clamp(depth / FOG_DISTANCE, 0.0f, 1.0f));
+#else
+	return color;
+#endif
+}
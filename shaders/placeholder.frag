@@ -0,0 +1,6 @@
+#version 330 core
+// Drawn while the real program is still compiling.
+out vec4 FragColor;
+void main() {
+	FragColor = vec4(0.5f, 0.5f, 0.5f, 1.0f);
+}
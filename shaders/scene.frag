@@ -0,0 +1,13 @@
+#version 330 core
+in vec3 world_pos;
+out vec4 FragColor;
+#include "common.glsl"
+#include "lighting.glsl"
+void main() {
+	// Flat shading, the cube has no vertex normals.
+	vec3 normal = normalize(cross(dFdx(world_pos), dFdy(world_pos)));
+	// gl_FragCoord.w is 1 / view depth under a perspective projection.
+	float depth = 1.0f / gl_FragCoord.w;
+	vec3 color = shade_clustered(gl_FragCoord.xy, depth, world_pos, normal, draw.color.rgb, draw.color.a);
+	FragColor = vec4(apply_fog(color, depth), 1.0f);
+}
@@ -0,0 +1,11 @@
+#version 330 core
+layout (location = 0) in vec3 pos;
+layout (location = 1) in mat4 model; // Per instance, locations 1-4.
+#include "common.glsl"
+out vec3 world_pos;
+invariant gl_Position; // Depth pre-pass and GL_EQUAL pass must match exactly.
+void main() {
+	vec4 world = draw.model * model * vec4(pos, 1.0f);
+	world_pos = world.xyz;
+	gl_Position = frame.view_proj * world;
+}
@@ -0,0 +1,8 @@
+#version 330 core
+layout (location = 0) in vec3 pos;
+layout (location = 1) in mat4 model; // Per instance, locations 1-4.
+#include "common.glsl"
+uniform mat4 light_view_proj; // Of the cascade being rendered.
+void main() {
+	gl_Position = light_view_proj * draw.model * model * vec4(pos, 1.0f);
+}
@@ -0,0 +1,125 @@
+#include <glad/glad.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "batch.h"
+
+StaticBatch static_batch_create(int stride) {
+	StaticBatch batch = {0};
+	batch.stride = stride;
+	return batch;
+}
+
+// Append a mesh, with every level of detail, transformed by `model`. Only the
+// position (the first three floats) is transformed. Returns the object's index.
+int static_batch_add(StaticBatch *batch, const MeshData *data, mat4 model) {
+	MeshData *page = batch->page_count ? &batch->page_data[batch->page_count - 1] : NULL;
+	if (!page || page->vertex_count + data->vertex_count > BATCH_PAGE_VERTICES) {
+		batch->page_count++;
+		batch->page_data = realloc(batch->page_data, batch->page_count * sizeof(MeshData));
+		page = &batch->page_data[batch->page_count - 1];
+		memset(page, 0, sizeof(*page));
+		page->stride = batch->stride;
+	}
+	if (batch->range_count == batch->range_capacity) {
+		batch->range_capacity = batch->range_capacity ? batch->range_capacity * 2 : 256;
+		batch->ranges = realloc(batch->ranges, batch->range_capacity * sizeof(BatchRange));
+	}
+
+	BatchRange *range = &batch->ranges[batch->range_count];
+	range->page = batch->page_count - 1;
+	range->base_vertex = page->vertex_count;
+	range->lod_count = data->lod_count > 0 ? data->lod_count : 1;
+	for (int i = 0; i < range->lod_count; i++) {
+		range->lods[i] = data->lod_count > 0 ? data->lods[i] : (MeshLod){0, data->index_count, 0.0f};
+		range->lods[i].first_index += page->index_count;
+	}
+
+	page->vertices = realloc(page->vertices, (page->vertex_count + data->vertex_count) * batch->stride * sizeof(float));
+	float *out = page->vertices + page->vertex_count * batch->stride;
+	memcpy(out, data->vertices, data->vertex_count * batch->stride * sizeof(float));
+	for (int v = 0; v < data->vertex_count; v++) {
+		glm_mat4_mulv3(model, out + v * batch->stride, 1.0f, out + v * batch->stride);
+	}
+	page->vertex_count += data->vertex_count;
+
+	page->indices = realloc(page->indices, (page->index_count + data->index_count) * sizeof(unsigned int));
+	memcpy(page->indices + page->index_count, data->indices, data->index_count * sizeof(unsigned int));
+	page->index_count += data->index_count;
+
+	return batch->range_count++;
+}
+
+// Upload every page and drop the CPU copies. No objects can be added afterwards.
+void static_batch_build(StaticBatch *batch) {
+	batch->pages = malloc(batch->page_count * sizeof(Mesh));
+	for (int p = 0; p < batch->page_count; p++) {
+		batch->pages[p] = mesh_upload(&batch->page_data[p]);
+		mesh_data_free(&batch->page_data[p]);
+	}
+	free(batch->page_data);
+	batch->page_data = NULL;
+
+	batch->counts = malloc(batch->range_count * sizeof(GLsizei));
+	batch->offsets = malloc(batch->range_count * sizeof(void *));
+	batch->base_vertices = malloc(batch->range_count * sizeof(GLint));
+	batch->page_first = malloc((batch->page_count + 1) * sizeof(int));
+	printf("Static batch: %d objects in %d pages\n", batch->range_count, batch->page_count);
+}
+
+// Draw `objects`, each at its level in `lods` (or full detail if NULL), with one
+// multi-draw per page. The program and uniforms must already be bound. Returns
+// the number of triangles drawn.
+int static_batch_draw(StaticBatch *batch, const int *objects, int count, const unsigned char *lods) {
+	// Bucket the draws by page.
+	memset(batch->page_first, 0, (batch->page_count + 1) * sizeof(int));
+	for (int i = 0; i < count; i++) {
+		batch->page_first[batch->ranges[objects[i]].page + 1]++;
+	}
+	for (int p = 0; p < batch->page_count; p++) {
+		batch->page_first[p + 1] += batch->page_first[p];
+	}
+
+	int triangles = 0;
+	for (int i = 0; i < count; i++) {
+		const BatchRange *range = &batch->ranges[objects[i]];
+		int level = lods && lods[objects[i]] < range->lod_count ? lods[objects[i]] : 0;
+		const MeshLod *lod = &range->lods[level];
+		int slot = batch->page_first[range->page]++;
+		batch->counts[slot] = lod->index_count;
+		batch->offsets[slot] = (void*)(lod->first_index * sizeof(unsigned int));
+		batch->base_vertices[slot] = range->base_vertex;
+		triangles += lod->index_count / 3;
+	}
+
+	// page_first now holds each page's end; the first page starts at 0.
+	batch->draw_calls = 0;
+	for (int p = 0, first = 0; p < batch->page_count; first = batch->page_first[p++]) {
+		int draws = batch->page_first[p] - first;
+		if (draws == 0) {
+			continue;
+		}
+		glBindVertexArray(batch->pages[p].vao);
+		glMultiDrawElementsBaseVertex(GL_TRIANGLES, batch->counts + first, GL_UNSIGNED_INT,
+			(const void *const *)(batch->offsets + first), draws, batch->base_vertices + first);
+		batch->draw_calls++;
+	}
+	return triangles;
+}
+
+void static_batch_destroy(StaticBatch *batch) {
+	for (int p = 0; p < batch->page_count && batch->pages; p++) {
+		mesh_destroy(&batch->pages[p]);
+	}
+	for (int p = 0; p < batch->page_count && batch->page_data; p++) {
+		mesh_data_free(&batch->page_data[p]);
+	}
+	free(batch->pages);
+	free(batch->page_data);
+	free(batch->ranges);
+	free(batch->counts);
+	free(batch->offsets);
+	free(batch->base_vertices);
+	free(batch->page_first);
+	memset(batch, 0, sizeof(*batch));
+}
@@ -0,0 +1,46 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <glad/glad.h>
+#include <cglm/cglm.h>
+#include "mesh.h"
+
+// Vertices per shared buffer. A new page starts when a mesh doesn't fit.
+#define BATCH_PAGE_VERTICES (1 << 20)
+
+// Where one object's geometry lives in the batch.
+typedef struct {
+	int page;
+	int base_vertex;
+	MeshLod lods[MESH_MAX_LODS]; // first_index into the page's element buffer.
+	int lod_count;
+} BatchRange;
+
+// Static objects pre-transformed to world space and packed into a few shared
+// vertex/index buffers, so every visible object of a page is drawn by one
+// glMultiDrawElementsBaseVertex. Indices are kept per mesh and offset by each
+// object's base vertex.
+typedef struct {
+	Mesh *pages;         // Uploaded by static_batch_build().
+	MeshData *page_data; // CPU side until then.
+	int page_count;
+	int stride;
+	BatchRange *ranges;  // One per object.
+	int range_count;
+	int range_capacity;
+
+	// Multi-draw arguments of the last draw, grouped by page.
+	GLsizei *counts;
+	void **offsets;
+	GLint *base_vertices;
+	int *page_first;
+	int draw_calls;
+} StaticBatch;
+
+StaticBatch static_batch_create(int stride);
+int static_batch_add(StaticBatch *batch, const MeshData *data, mat4 model);
+void static_batch_build(StaticBatch *batch);
+int static_batch_draw(StaticBatch *batch, const int *objects, int count, const unsigned char *lods);
+void static_batch_destroy(StaticBatch *batch);
+
+#endif
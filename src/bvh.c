@@ -0,0 +1,404 @@
+#include <assert.h>
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bvh.h"
+
+#define BVH_BINS 16
+#define BVH_MAX_LEAF 4     // Leaves may hold more only when primitives can't be split.
+#define BVH_TRAVERSAL_COST 1.0f // Relative to one primitive test.
+#define BVH_STACK_SIZE 64 // Traversal stack entries. Builds keep leaves shallower than this.
+
+typedef struct {
+	Bvh *bvh;
+	vec3 (*boxes)[2];
+	vec3 *centroids;
+} BvhBuilder;
+
+static float surface_area(vec3 box[2]) {
+	vec3 size;
+	glm_vec3_sub(box[1], box[0], size);
+	if (size[0] < 0.0f) {
+		return 0.0f; // Empty.
+	}
+	return 2.0f * (size[0] * size[1] + size[1] * size[2] + size[2] * size[0]);
+}
+
+static void grow(vec3 box[2], vec3 other[2]) {
+	glm_vec3_minv(box[0], other[0], box[0]);
+	glm_vec3_maxv(box[1], other[1], box[1]);
+}
+
+static int centroid_bin(const float *centroid, int axis, float min, float scale) {
+	int bin = (int)((centroid[axis] - min) * scale);
+	return bin < BVH_BINS - 1 ? bin : BVH_BINS - 1;
+}
+
+// Levels a subtree of `count` primitives needs when split in halves.
+static int halving_depth(int count) {
+	int levels = 0;
+	while ((1 << levels) < count) {
+		levels++;
+	}
+	return levels;
+}
+
+// Build the subtree of `node_index`, at `depth`, over indices [first, first + count)
+// with a binned surface area heuristic.
+static void build_node(BvhBuilder *builder, int node_index, int depth, int first, int count) {
+	Bvh *bvh = builder->bvh;
+	int *indices = bvh->indices;
+	BvhNode *node = &bvh->nodes[node_index];
+
+	vec3 centroid_bounds[2];
+	glm_aabb_invalidate(node->bounds);
+	glm_aabb_invalidate(centroid_bounds);
+	for (int i = first; i < first + count; i++) {
+		grow(node->bounds, builder->boxes[indices[i]]);
+		glm_vec3_minv(centroid_bounds[0], builder->centroids[indices[i]], centroid_bounds[0]);
+		glm_vec3_maxv(centroid_bounds[1], builder->centroids[indices[i]], centroid_bounds[1]);
+	}
+	node->offset = first;
+	node->count = count;
+	if (count <= 1) {
+		return;
+	}
+
+	// SAH splits can peel off one primitive per level, e.g. on exponentially
+	// spaced objects. Once that could outgrow the traversal stacks, split the list
+	// in halves instead, which bounds the rest of the subtree.
+	int halve = depth + halving_depth(count) >= BVH_STACK_SIZE - 1;
+
+	// Cheapest split plane over all axes, evaluated at bin boundaries.
+	float best_cost = FLT_MAX;
+	int best_axis = -1;
+	int best_split = 0;
+	for (int axis = 0; axis < 3 && !halve; axis++) {
+		float extent = centroid_bounds[1][axis] - centroid_bounds[0][axis];
+		if (extent <= 0.0f) {
+			continue;
+		}
+		float scale = BVH_BINS / extent;
+
+		int bin_count[BVH_BINS] = {0};
+		vec3 bin_bounds[BVH_BINS][2];
+		for (int b = 0; b < BVH_BINS; b++) {
+			glm_aabb_invalidate(bin_bounds[b]);
+		}
+		for (int i = first; i < first + count; i++) {
+			int b = centroid_bin(builder->centroids[indices[i]], axis, centroid_bounds[0][axis], scale);
+			bin_count[b]++;
+			grow(bin_bounds[b], builder->boxes[indices[i]]);
+		}
+
+		// Sweep from the right first so the left sweep can evaluate costs directly.
+		float right_area[BVH_BINS];
+		int right_count[BVH_BINS];
+		vec3 box[2];
+		glm_aabb_invalidate(box);
+		int n = 0;
+		for (int b = BVH_BINS - 1; b > 0; b--) {
+			grow(box, bin_bounds[b]);
+			n += bin_count[b];
+			right_area[b] = surface_area(box);
+			right_count[b] = n;
+		}
+
+		glm_aabb_invalidate(box);
+		n = 0;
+		for (int b = 0; b < BVH_BINS - 1; b++) {
+			grow(box, bin_bounds[b]);
+			n += bin_count[b];
+			if (n == 0 || right_count[b + 1] == 0) {
+				continue;
+			}
+			float cost = surface_area(box) * n + right_area[b + 1] * right_count[b + 1];
+			if (cost < best_cost) {
+				best_cost = cost;
+				best_axis = axis;
+				best_split = b;
+			}
+		}
+	}
+
+	// Keep a leaf when splitting wouldn't pay for the extra traversal step.
+	float area = surface_area(node->bounds);
+	float leaf_cost = count * area;
+	if (!halve && count <= BVH_MAX_LEAF && (best_axis < 0 || BVH_TRAVERSAL_COST * area + best_cost >= leaf_cost)) {
+		return;
+	}
+
+	int left_count;
+	if (best_axis >= 0) {
+		float scale = BVH_BINS / (centroid_bounds[1][best_axis] - centroid_bounds[0][best_axis]);
+		int i = first;
+		int j = first + count - 1;
+		while (i <= j) {
+			if (centroid_bin(builder->centroids[indices[i]], best_axis, centroid_bounds[0][best_axis], scale) <= best_split) {
+				i++;
+			} else {
+				int swap = indices[i];
+				indices[i] = indices[j];
+				indices[j--] = swap;
+			}
+		}
+		left_count = i - first;
+	} else {
+		left_count = count / 2; // All centroids coincide or the tree is too deep, split the list in half.
+	}
+
+	int left = bvh->node_count++; // Always node_index + 1.
+	build_node(builder, left, depth + 1, first, left_count);
+	int right = bvh->node_count++;
+	build_node(builder, right, depth + 1, first + left_count, count - left_count);
+
+	node = &bvh->nodes[node_index];
+	node->offset = right;
+	node->count = 0;
+}
+
+// Build over `count` primitive boxes in glm_aabb layout.
+Bvh bvh_build(vec3 (*boxes)[2], int count) {
+	Bvh bvh = {0};
+	bvh.count = count;
+	bvh.indices = malloc(count * sizeof(int));
+	bvh.nodes = malloc((count > 0 ? 2 * count - 1 : 1) * sizeof(BvhNode));
+	if (count <= 0) {
+		return bvh;
+	}
+
+	BvhBuilder builder = {&bvh, boxes, malloc(count * sizeof(vec3))};
+	for (int i = 0; i < count; i++) {
+		bvh.indices[i] = i;
+		glm_aabb_center(boxes[i], builder.centroids[i]);
+	}
+
+	bvh.node_count = 1;
+	build_node(&builder, 0, 0, 0, count);
+	free(builder.centroids);
+	bvh.nodes = realloc(bvh.nodes, bvh.node_count * sizeof(BvhNode));
+	return bvh;
+}
+
+// Update node bounds after primitives moved, keeping the topology. Children
+// always come after their parent, so one reverse pass is enough.
+void bvh_refit(Bvh *bvh, vec3 (*boxes)[2]) {
+	for (int i = bvh->node_count - 1; i >= 0; i--) {
+		BvhNode *node = &bvh->nodes[i];
+		if (node->count > 0) {
+			glm_aabb_invalidate(node->bounds);
+			for (int p = node->offset; p < node->offset + node->count; p++) {
+				grow(node->bounds, boxes[bvh->indices[p]]);
+			}
+		} else {
+			glm_aabb_merge(bvh->nodes[i + 1].bounds, bvh->nodes[node->offset].bounds, node->bounds);
+		}
+	}
+}
+
+// Whether a box is completely on the inner side of every plane.
+static int box_inside_frustum(vec3 box[2], vec4 planes[6]) {
+	for (int p = 0; p < 6; p++) {
+		// Corner farthest behind the plane.
+		float d = planes[p][3];
+		for (int k = 0; k < 3; k++) {
+			d += planes[p][k] * (planes[p][k] > 0.0f ? box[0][k] : box[1][k]);
+		}
+		if (d < 0.0f) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// Collect every primitive whose box intersects the frustum. Subtrees fully
+// inside are taken whole, without testing their children.
+int bvh_frustum(const Bvh *bvh, vec4 planes[6], int *visible) {
+	if (bvh->node_count == 0) {
+		return 0;
+	}
+
+	int count = 0;
+	int stack[BVH_STACK_SIZE]; // Node index * 2 + fully inside flag.
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		int entry = stack[--top];
+		BvhNode *node = &bvh->nodes[entry >> 1];
+		int inside = entry & 1;
+		if (!inside) {
+			if (!glm_aabb_frustum(node->bounds, planes)) {
+				continue;
+			}
+			inside = box_inside_frustum(node->bounds, planes);
+		}
+
+		if (node->count > 0) {
+			for (int p = node->offset; p < node->offset + node->count; p++) {
+				visible[count++] = bvh->indices[p];
+			}
+		} else {
+			int left = (entry >> 1) + 1;
+			assert(top + 2 <= BVH_STACK_SIZE);
+			stack[top++] = node->offset * 2 + inside;
+			stack[top++] = left * 2 + inside;
+		}
+	}
+	return count;
+}
+
+// Slab test. Returns the entry distance, or FLT_MAX on a miss or when the box
+// is farther than `max_t`.
+static float ray_box(vec3 box[2], vec3 origin, vec3 inv_dir, float max_t) {
+	float t_min = 0.0f;
+	float t_max = max_t;
+	for (int k = 0; k < 3; k++) {
+		float t1 = (box[0][k] - origin[k]) * inv_dir[k];
+		float t2 = (box[1][k] - origin[k]) * inv_dir[k];
+		t_min = glm_max(t_min, glm_min(t1, t2));
+		t_max = glm_min(t_max, glm_max(t1, t2));
+	}
+	return t_min <= t_max ? t_min : FLT_MAX;
+}
+
+// Closest hit traversal, calling `hit` with leaf slots. Returns the hit slot or -1.
+// Nearer children are visited first, and subtrees behind the best hit so far skipped.
+static int raycast_slots(const Bvh *bvh, vec3 origin, vec3 dir, BvhHitFn hit, void *ctx, float *distance) {
+	int result = -1;
+	float best = FLT_MAX;
+	if (bvh->node_count == 0) {
+		return result;
+	}
+
+	vec3 inv_dir;
+	for (int k = 0; k < 3; k++) {
+		inv_dir[k] = dir[k] != 0.0f ? 1.0f / dir[k] : FLT_MAX;
+	}
+
+	struct { int node; float t; } stack[BVH_STACK_SIZE];
+	int top = 0;
+	float t = ray_box(bvh->nodes[0].bounds, origin, inv_dir, best);
+	if (t == FLT_MAX) {
+		return result;
+	}
+	stack[top].node = 0;
+	stack[top++].t = t;
+
+	while (top > 0) {
+		top--;
+		if (stack[top].t >= best) {
+			continue;
+		}
+		BvhNode *node = &bvh->nodes[stack[top].node];
+
+		if (node->count > 0) {
+			for (int slot = node->offset; slot < node->offset + node->count; slot++) {
+				float d = hit(ctx, slot, origin, dir);
+				if (d >= 0.0f && d < best) {
+					best = d;
+					result = slot;
+				}
+			}
+			continue;
+		}
+
+		int near = stack[top].node + 1;
+		int far = node->offset;
+		float t_near = ray_box(bvh->nodes[near].bounds, origin, inv_dir, best);
+		float t_far = ray_box(bvh->nodes[far].bounds, origin, inv_dir, best);
+		if (t_far < t_near) {
+			int swap = near;
+			near = far;
+			far = swap;
+			float swap_t = t_near;
+			t_near = t_far;
+			t_far = swap_t;
+		}
+		assert(top + 2 <= BVH_STACK_SIZE);
+		if (t_far != FLT_MAX) {
+			stack[top].node = far;
+			stack[top++].t = t_far;
+		}
+		if (t_near != FLT_MAX) {
+			stack[top].node = near;
+			stack[top++].t = t_near;
+		}
+	}
+
+	if (distance) {
+		*distance = best;
+	}
+	return result;
+}
+
+typedef struct {
+	const Bvh *bvh;
+	BvhHitFn hit;
+	void *ctx;
+} PrimitiveHit;
+
+static float hit_primitive(void *data, int slot, vec3 origin, vec3 dir) {
+	PrimitiveHit *primitive = data;
+	return primitive->hit(primitive->ctx, primitive->bvh->indices[slot], origin, dir);
+}
+
+// Closest hit along a ray. Returns the hit primitive and its distance, or -1.
+int bvh_raycast(const Bvh *bvh, vec3 origin, vec3 dir, BvhHitFn hit, void *ctx, float *distance) {
+	PrimitiveHit primitive = {bvh, hit, ctx};
+	int slot = raycast_slots(bvh, origin, dir, hit_primitive, &primitive, distance);
+	return slot >= 0 ? bvh->indices[slot] : -1;
+}
+
+void bvh_destroy(Bvh *bvh) {
+	free(bvh->nodes);
+	free(bvh->indices);
+	memset(bvh, 0, sizeof(*bvh));
+}
+
+// Triangle BVH over an indexed (or, with NULL indices, unindexed) triangle list.
+MeshBvh mesh_bvh_build(const float *vertices, const unsigned int *indices, int index_count, int stride) {
+	MeshBvh mesh_bvh = {0};
+	int tri_count = index_count / 3;
+	vec3 (*triangles)[3] = malloc(tri_count * sizeof(*triangles));
+	vec3 (*boxes)[2] = malloc(tri_count * sizeof(*boxes));
+
+	for (int t = 0; t < tri_count; t++) {
+		glm_aabb_invalidate(boxes[t]);
+		for (int k = 0; k < 3; k++) {
+			int v = indices ? (int)indices[t * 3 + k] : t * 3 + k;
+			glm_vec3_copy((float *)(vertices + v * stride), triangles[t][k]);
+			glm_vec3_minv(boxes[t][0], triangles[t][k], boxes[t][0]);
+			glm_vec3_maxv(boxes[t][1], triangles[t][k], boxes[t][1]);
+		}
+	}
+	mesh_bvh.bvh = bvh_build(boxes, tri_count);
+
+	// Store triangles in leaf order, so a leaf's triangles are adjacent in memory.
+	mesh_bvh.triangles = malloc(tri_count * sizeof(*triangles));
+	for (int i = 0; i < tri_count; i++) {
+		memcpy(mesh_bvh.triangles[i], triangles[mesh_bvh.bvh.indices[i]], sizeof(*triangles));
+	}
+
+	free(boxes);
+	free(triangles);
+	return mesh_bvh;
+}
+
+static float hit_triangle(void *ctx, int slot, vec3 origin, vec3 dir) {
+	const MeshBvh *mesh_bvh = ctx;
+	vec3 *triangle = mesh_bvh->triangles[slot];
+	float d;
+	return glm_ray_triangle(origin, dir, triangle[0], triangle[1], triangle[2], &d) ? d : -1.0f;
+}
+
+// Returns the hit triangle's index in the original triangle list, or -1.
+int mesh_bvh_raycast(const MeshBvh *mesh_bvh, vec3 origin, vec3 dir, float *distance) {
+	int slot = raycast_slots(&mesh_bvh->bvh, origin, dir, hit_triangle, (void *)mesh_bvh, distance);
+	return slot >= 0 ? mesh_bvh->bvh.indices[slot] : -1;
+}
+
+void mesh_bvh_destroy(MeshBvh *mesh_bvh) {
+	bvh_destroy(&mesh_bvh->bvh);
+	free(mesh_bvh->triangles);
+	memset(mesh_bvh, 0, sizeof(*mesh_bvh));
+}
@@ -0,0 +1,42 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <cglm/cglm.h>
+
+// 32 byte node, stored depth first. An internal node's left child directly
+// follows it and `offset` is its right child; a leaf has `count` primitives
+// starting at `offset` in Bvh.indices.
+typedef struct {
+	vec3 bounds[2]; // glm_aabb layout.
+	int offset;
+	int count; // 0 for internal nodes.
+} BvhNode;
+
+typedef struct {
+	BvhNode *nodes;
+	int node_count;
+	int *indices; // Primitive index of each leaf slot.
+	int count;
+} Bvh;
+
+// Precise hit test of one primitive. Returns the hit distance along the ray,
+// or a negative value for a miss.
+typedef float (*BvhHitFn)(void *ctx, int primitive, vec3 origin, vec3 dir);
+
+Bvh bvh_build(vec3 (*boxes)[2], int count);
+void bvh_refit(Bvh *bvh, vec3 (*boxes)[2]);
+int bvh_frustum(const Bvh *bvh, vec4 planes[6], int *visible);
+int bvh_raycast(const Bvh *bvh, vec3 origin, vec3 dir, BvhHitFn hit, void *ctx, float *distance);
+void bvh_destroy(Bvh *bvh);
+
+// Triangle BVH of one mesh, with triangles copied in leaf order.
+typedef struct {
+	Bvh bvh;
+	vec3 (*triangles)[3];
+} MeshBvh;
+
+MeshBvh mesh_bvh_build(const float *vertices, const unsigned int *indices, int index_count, int stride);
+int mesh_bvh_raycast(const MeshBvh *mesh_bvh, vec3 origin, vec3 dir, float *distance);
+void mesh_bvh_destroy(MeshBvh *mesh_bvh);
+
+#endif
@@ -0,0 +1,239 @@
+#include <glad/glad.h>
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cluster.h"
+#include "simd.h"
+#include "ubo.h"
+
+#define SLICE_CLUSTERS (CLUSTER_GRID_X * CLUSTER_GRID_Y)
+
+static unsigned int create_buffer_texture(unsigned int *buffer) {
+	unsigned int texture;
+	glGenBuffers(1, buffer);
+	glGenTextures(1, &texture);
+	return texture;
+}
+
+LightClusters clusters_create(int max_lights, float near_z, float far_z) {
+	LightClusters clusters = {0};
+	if (max_lights > CLUSTER_LIGHT_LIMIT) {
+		printf("%d lights requested, clustering is limited to %d\n", max_lights, CLUSTER_LIGHT_LIMIT);
+		max_lights = CLUSTER_LIGHT_LIMIT;
+	}
+	clusters.capacity = max_lights;
+	clusters.near_z = near_z;
+	clusters.far_z = far_z;
+	for (int i = 0; i < 6; i++) {
+		clusters.bounds[i] = malloc(CLUSTER_COUNT * sizeof(float));
+	}
+	clusters.light_x = malloc((max_lights + 1) * sizeof(float));
+	clusters.light_y = malloc((max_lights + 1) * sizeof(float));
+	clusters.light_z = malloc((max_lights + 1) * sizeof(float));
+	clusters.light_radius = malloc((max_lights + 1) * sizeof(float));
+	clusters.slots = malloc(CLUSTER_COUNT * CLUSTER_MAX_LIGHTS * sizeof(unsigned short));
+	clusters.counts = calloc(CLUSTER_COUNT, sizeof(int));
+	clusters.grid = calloc(CLUSTER_COUNT * 2, sizeof(unsigned int));
+	clusters.indices = malloc(CLUSTER_COUNT * CLUSTER_MAX_LIGHTS * sizeof(unsigned short));
+
+	clusters.light_texture = create_buffer_texture(&clusters.light_buffer);
+	clusters.grid_texture = create_buffer_texture(&clusters.grid_buffer);
+	clusters.index_texture = create_buffer_texture(&clusters.index_buffer);
+	glGenBuffers(1, &clusters.uniform_buffer);
+	return clusters;
+}
+
+// Bind a program's Clusters block and light samplers. Programs without lighting
+// pass untouched.
+int clusters_bind_program(const ShaderProgram *program) {
+	const ShaderBlock *block = shader_find_block(program, "Clusters");
+	if (!block) {
+		return 1;
+	}
+	if (!shader_check_block(program, "Clusters", sizeof(ClusterUniforms))) {
+		return 0;
+	}
+	glUniformBlockBinding(program->id, block->index, UBO_BINDING_CLUSTERS);
+
+	UniformHandle lights = shader_uniform(program, "light_data", GL_SAMPLER_BUFFER);
+	UniformHandle grid = shader_uniform(program, "cluster_grid", GL_UNSIGNED_INT_SAMPLER_BUFFER);
+	UniformHandle indices = shader_uniform(program, "light_indices", GL_UNSIGNED_INT_SAMPLER_BUFFER);
+	if (lights.location < 0 || grid.location < 0 || indices.location < 0) {
+		return 0;
+	}
+	glUseProgram(program->id);
+	shader_set_int(lights, CLUSTER_UNIT_LIGHTS);
+	shader_set_int(grid, CLUSTER_UNIT_GRID);
+	shader_set_int(indices, CLUSTER_UNIT_INDICES);
+	return 1;
+}
+
+// View space point at `depth` along the ray through an NDC position.
+static void view_point(mat4 inverse_proj, float x, float y, float depth, vec3 dest) {
+	vec4 point;
+	glm_mat4_mulv(inverse_proj, (vec4){x, y, -1.0f, 1.0f}, point);
+	glm_vec3_scale(point, 1.0f / point[3], dest);
+	glm_vec3_scale(dest, depth / -dest[2], dest);
+}
+
+static float slice_depth(const LightClusters *clusters, int slice) {
+	return clusters->near_z * powf(clusters->far_z / clusters->near_z, (float)slice / CLUSTER_GRID_Z);
+}
+
+// Build the view space bounds of every cluster from the corners of its tile at
+// its slice's near and far depth.
+static void build_bounds(LightClusters *clusters, mat4 proj) {
+	mat4 inverse_proj;
+	glm_mat4_inv(proj, inverse_proj);
+	glm_mat4_copy(proj, clusters->proj);
+
+	for (int z = 0; z < CLUSTER_GRID_Z; z++) {
+		float depths[2] = {slice_depth(clusters, z), slice_depth(clusters, z + 1)};
+		for (int y = 0; y < CLUSTER_GRID_Y; y++) {
+			for (int x = 0; x < CLUSTER_GRID_X; x++) {
+				int cluster = x + CLUSTER_GRID_X * (y + CLUSTER_GRID_Y * z);
+				vec3 box[2] = {{FLT_MAX, FLT_MAX, FLT_MAX}, {-FLT_MAX, -FLT_MAX, -FLT_MAX}};
+				for (int corner = 0; corner < 8; corner++) {
+					float ndc_x = (float)(x + (corner & 1)) / CLUSTER_GRID_X * 2.0f - 1.0f;
+					float ndc_y = (float)(y + (corner >> 1 & 1)) / CLUSTER_GRID_Y * 2.0f - 1.0f;
+					vec3 point;
+					view_point(inverse_proj, ndc_x, ndc_y, depths[corner >> 2], point);
+					glm_vec3_minv(box[0], point, box[0]);
+					glm_vec3_maxv(box[1], point, box[1]);
+				}
+				for (int i = 0; i < 3; i++) {
+					clusters->bounds[i][cluster] = box[0][i];
+					clusters->bounds[3 + i][cluster] = box[1][i];
+				}
+			}
+		}
+	}
+}
+
+// Test every light that overlaps one depth slice against the slice's clusters,
+// SIMD_WIDTH clusters at a time, sphere against AABB.
+static void bin_slice(void *ctx, int z) {
+	LightClusters *clusters = ctx;
+	float slice_near = -slice_depth(clusters, z);
+	float slice_far = -slice_depth(clusters, z + 1);
+	int first = z * SLICE_CLUSTERS;
+	int *counts = clusters->counts + first;
+	memset(counts, 0, SLICE_CLUSTERS * sizeof(int));
+
+	for (int light = 0; light < clusters->light_count; light++) {
+		float cz = clusters->light_z[light], radius = clusters->light_radius[light];
+		if (cz - radius > slice_near || cz + radius < slice_far) {
+			continue;
+		}
+
+		vfloat x = v_set1(clusters->light_x[light]);
+		vfloat y = v_set1(clusters->light_y[light]);
+		vfloat vz = v_set1(cz);
+		vfloat radius_squared = v_set1(radius * radius);
+		vfloat zero = v_set1(0.0f);
+		for (int i = 0; i < SLICE_CLUSTERS; i += SIMD_WIDTH) {
+			int cluster = first + i;
+			// Distance from the center to the box along each axis, 0 inside.
+			vfloat dx = v_max(v_max(v_sub(v_load(clusters->bounds[0] + cluster), x), v_sub(x, v_load(clusters->bounds[3] + cluster))), zero);
+			vfloat dy = v_max(v_max(v_sub(v_load(clusters->bounds[1] + cluster), y), v_sub(y, v_load(clusters->bounds[4] + cluster))), zero);
+			vfloat dz = v_max(v_max(v_sub(v_load(clusters->bounds[2] + cluster), vz), v_sub(vz, v_load(clusters->bounds[5] + cluster))), zero);
+			vfloat distance_squared = v_add(v_add(v_mul(dx, dx), v_mul(dy, dy)), v_mul(dz, dz));
+			int mask = v_movemask(v_ge(radius_squared, distance_squared));
+			for (int lane = 0; mask && lane < SIMD_WIDTH; lane++) {
+				if (!(mask >> lane & 1)) {
+					continue;
+				}
+				int *count = &counts[i + lane];
+				if (*count < CLUSTER_MAX_LIGHTS) {
+					clusters->slots[(cluster + lane) * CLUSTER_MAX_LIGHTS + *count] = (unsigned short)light;
+				}
+				(*count)++;
+			}
+		}
+	}
+}
+
+// Bin `count` lights into the clusters of the camera described by `view` and
+// `proj`, spreading the depth slices over the job system.
+void clusters_bin(LightClusters *clusters, JobSystem *jobs, const PointLight *lights, int count, mat4 view, mat4 proj) {
+	if (memcmp(proj, clusters->proj, sizeof(mat4)) != 0) {
+		build_bounds(clusters, proj);
+	}
+
+	clusters->light_count = count < clusters->capacity ? count : clusters->capacity;
+	for (int i = 0; i < clusters->light_count; i++) {
+		vec3 center;
+		glm_mat4_mulv3(view, (float *)lights[i].position, 1.0f, center);
+		clusters->light_x[i] = center[0];
+		clusters->light_y[i] = center[1];
+		clusters->light_z[i] = center[2];
+		clusters->light_radius[i] = lights[i].radius;
+	}
+	jobs_run(jobs, bin_slice, clusters, CLUSTER_GRID_Z);
+
+	// Compact the fixed size lists into one index list.
+	clusters->index_count = 0;
+	clusters->overflows = 0;
+	for (int i = 0; i < CLUSTER_COUNT; i++) {
+		int cluster_count = clusters->counts[i];
+		if (cluster_count > CLUSTER_MAX_LIGHTS) {
+			cluster_count = CLUSTER_MAX_LIGHTS;
+			clusters->overflows++;
+		}
+		clusters->grid[i * 2] = clusters->index_count;
+		clusters->grid[i * 2 + 1] = cluster_count;
+		memcpy(clusters->indices + clusters->index_count, clusters->slots + i * CLUSTER_MAX_LIGHTS, cluster_count * sizeof(unsigned short));
+		clusters->index_count += cluster_count;
+	}
+}
+
+static void upload(unsigned int buffer, unsigned int texture, int unit, GLenum format, const void *data, size_t size) {
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+	glBufferData(GL_TEXTURE_BUFFER, size, data, GL_STREAM_DRAW); // Orphan.
+	glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(GL_TEXTURE_BUFFER, texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+}
+
+// Upload the binned lights and bind them for every lit program. After
+// clusters_bin(), with the same lights.
+void clusters_upload(LightClusters *clusters, const PointLight *lights, int width, int height) {
+	// Empty buffers can't back a texture, so there is always one element.
+	size_t light_size = (clusters->light_count > 0 ? clusters->light_count : 1) * sizeof(PointLight);
+	size_t index_size = (clusters->index_count > 0 ? clusters->index_count : 1) * sizeof(unsigned short);
+	PointLight none = {0};
+	upload(clusters->light_buffer, clusters->light_texture, CLUSTER_UNIT_LIGHTS, GL_RGBA32F, clusters->light_count > 0 ? lights : &none, light_size);
+	upload(clusters->grid_buffer, clusters->grid_texture, CLUSTER_UNIT_GRID, GL_RG32UI, clusters->grid, CLUSTER_COUNT * 2 * sizeof(unsigned int));
+	upload(clusters->index_buffer, clusters->index_texture, CLUSTER_UNIT_INDICES, GL_R16UI, clusters->indices, index_size);
+	glActiveTexture(GL_TEXTURE0);
+
+	float log_ratio = logf(clusters->far_z / clusters->near_z);
+	ClusterUniforms uniforms = {
+		{CLUSTER_GRID_X, CLUSTER_GRID_Y, CLUSTER_GRID_Z, 0.0f},
+		{CLUSTER_GRID_Z / log_ratio, -CLUSTER_GRID_Z * logf(clusters->near_z) / log_ratio, 0.0f, 0.0f},
+		{(float)width, (float)height, 0.0f, 0.0f}
+	};
+	glBindBuffer(GL_UNIFORM_BUFFER, clusters->uniform_buffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(ClusterUniforms), &uniforms, GL_DYNAMIC_DRAW); // Orphan.
+	glBindBufferBase(GL_UNIFORM_BUFFER, UBO_BINDING_CLUSTERS, clusters->uniform_buffer);
+}
+
+void clusters_destroy(LightClusters *clusters) {
+	unsigned int buffers[4] = {clusters->light_buffer, clusters->grid_buffer, clusters->index_buffer, clusters->uniform_buffer};
+	unsigned int textures[3] = {clusters->light_texture, clusters->grid_texture, clusters->index_texture};
+	glDeleteBuffers(4, buffers);
+	glDeleteTextures(3, textures);
+	for (int i = 0; i < 6; i++) {
+		free(clusters->bounds[i]);
+	}
+	free(clusters->light_x);
+	free(clusters->light_y);
+	free(clusters->light_z);
+	free(clusters->light_radius);
+	free(clusters->slots);
+	free(clusters->counts);
+	free(clusters->grid);
+	free(clusters->indices);
+	memset(clusters, 0, sizeof(*clusters));
+}
@@ -0,0 +1,69 @@
+#ifndef CLUSTER_H
+#define CLUSTER_H
+
+#include <cglm/cglm.h>
+#include "jobs.h"
+#include "shader.h"
+
+// Froxel grid: screen tiles by exponential depth slices between the clip planes.
+// 16x16 tiles keep every slice a multiple of the SIMD width.
+#define CLUSTER_GRID_X 16
+#define CLUSTER_GRID_Y 16
+#define CLUSTER_GRID_Z 24
+#define CLUSTER_COUNT (CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z)
+#define CLUSTER_MAX_LIGHTS 128 // Per cluster, further lights are dropped.
+#define CLUSTER_LIGHT_LIMIT 65535 // Light indices are 16 bit.
+
+// Texture units of the light buffers.
+#define CLUSTER_UNIT_LIGHTS 1
+#define CLUSTER_UNIT_GRID 2
+#define CLUSTER_UNIT_INDICES 3
+
+// Two RGBA32F texels in the light buffer texture.
+typedef struct {
+	vec3 position; // World space.
+	float radius;
+	vec3 color;
+	float padding;
+} PointLight;
+
+// std140 "Clusters" block.
+typedef struct {
+	vec4 grid;    // Tiles in x and y, slices in z.
+	vec4 slicing; // Slice of a view depth is log(depth) * x + y.
+	vec4 screen;  // Viewport size in pixels.
+} ClusterUniforms;
+
+// Clustered forward lighting. Lights are binned into the froxels they touch on
+// the CPU, one depth slice per job, and the shaders read each fragment's light
+// list from buffer textures.
+typedef struct {
+	mat4 proj; // Projection the bounds were built for.
+	float near_z, far_z;
+	float *bounds[6]; // View space AABB of every cluster, SoA min xyz then max xyz.
+
+	// Lights in view space, SoA, for binning.
+	int capacity;
+	float *light_x, *light_y, *light_z, *light_radius;
+	int light_count;
+
+	// Binning output. Each cluster owns CLUSTER_MAX_LIGHTS slots in `slots`.
+	unsigned short *slots;
+	int *counts;
+	unsigned int *grid;     // Offset and count of every cluster, uploaded.
+	unsigned short *indices; // Compacted light lists, uploaded.
+	int index_count;
+	int overflows; // Clusters that hit CLUSTER_MAX_LIGHTS last frame.
+
+	unsigned int light_buffer, grid_buffer, index_buffer;
+	unsigned int light_texture, grid_texture, index_texture;
+	unsigned int uniform_buffer;
+} LightClusters;
+
+LightClusters clusters_create(int max_lights, float near_z, float far_z);
+int clusters_bind_program(const ShaderProgram *program);
+void clusters_bin(LightClusters *clusters, JobSystem *jobs, const PointLight *lights, int count, mat4 view, mat4 proj);
+void clusters_upload(LightClusters *clusters, const PointLight *lights, int width, int height);
+void clusters_destroy(LightClusters *clusters);
+
+#endif
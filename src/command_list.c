@@ -0,0 +1,73 @@
+#include <stdlib.h>
+#include <string.h>
+#include "command_list.h"
+
+void command_list_clear(CommandList *list) {
+	list->count = 0;
+}
+
+void command_list_draw(CommandList *list, const DrawCommand *command, const DrawUniforms *uniforms) {
+	if (list->count == list->capacity) {
+		list->capacity = list->capacity ? list->capacity * 2 : 256;
+		list->commands = realloc(list->commands, list->capacity * sizeof(DrawCommand));
+		list->uniforms = realloc(list->uniforms, list->capacity * sizeof(DrawUniforms));
+	}
+
+	list->commands[list->count] = *command;
+	list->uniforms[list->count] = *uniforms;
+	list->count++;
+}
+
+void command_list_destroy(CommandList *list) {
+	free(list->commands);
+	free(list->uniforms);
+	memset(list, 0, sizeof(*list));
+}
+
+typedef struct {
+	CommandList *lists;
+	RecordFn record;
+	void *ctx;
+} RecordJob;
+
+static void record_bucket(void *data, int bucket) {
+	RecordJob *job = data;
+	CommandList *list = &job->lists[bucket];
+	command_list_clear(list);
+	job->record(list, bucket, job->ctx);
+}
+
+// Record one list per bucket in parallel. `lists` needs `bucket_count` entries.
+void command_lists_record(JobSystem *jobs, CommandList *lists, int bucket_count, RecordFn record, void *ctx) {
+	RecordJob job = {lists, record, ctx};
+	jobs_run(jobs, record_bucket, &job, bucket_count);
+}
+
+// Merge recorded lists into the render queue. Render thread only: each list's
+// constants go to the UBO ring in one write, then every command becomes a packet.
+// The queue still has to be sorted and submitted.
+void command_lists_replay(CommandList *lists, int list_count, UboSystem *ubo, RenderQueue *queue) {
+	for (int l = 0; l < list_count; l++) {
+		CommandList *list = &lists[l];
+		if (list->count == 0) {
+			continue;
+		}
+
+		size_t base = ubo_push_draws(ubo, list->uniforms, list->count);
+		if (base == (size_t)-1) {
+			continue; // Ring full, already reported.
+		}
+
+		for (int i = 0; i < list->count; i++) {
+			const DrawCommand *command = &list->commands[i];
+			DrawPacket *packet = render_queue_push(queue, command->key);
+			packet->program = command->program;
+			packet->vao = command->vao;
+			packet->draw_offset = ubo_draw_offset(ubo, base, i);
+			packet->first_index = command->first_index;
+			packet->index_count = command->index_count;
+			packet->instance_count = command->instance_count;
+			packet->condition = command->condition;
+		}
+	}
+}
@@ -0,0 +1,38 @@
+#ifndef COMMAND_LIST_H
+#define COMMAND_LIST_H
+
+#include <stdint.h>
+#include "jobs.h"
+#include "ubo.h"
+#include "render_queue.h"
+
+// One recorded draw. Only handles and data, no GL calls, so any thread can record.
+typedef struct {
+	uint64_t key;
+	unsigned int program;
+	unsigned int vao;
+	int first_index;
+	int index_count;
+	int instance_count;
+	unsigned int condition; // See DrawPacket.
+} DrawCommand;
+
+// Draws recorded by one worker, with their per-draw constants alongside.
+typedef struct {
+	DrawCommand *commands;
+	DrawUniforms *uniforms;
+	int count;
+	int capacity;
+} CommandList;
+
+// Records the draws of one culling bucket into `list`.
+typedef void (*RecordFn)(CommandList *list, int bucket, void *ctx);
+
+void command_list_clear(CommandList *list);
+void command_list_draw(CommandList *list, const DrawCommand *command, const DrawUniforms *uniforms);
+void command_list_destroy(CommandList *list);
+
+void command_lists_record(JobSystem *jobs, CommandList *lists, int bucket_count, RecordFn record, void *ctx);
+void command_lists_replay(CommandList *lists, int list_count, UboSystem *ubo, RenderQueue *queue);
+
+#endif
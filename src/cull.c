@@ -0,0 +1,196 @@
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cull.h"
+#include "simd.h"
+
+// Objects tested per batch.
+#define CULL_WIDTH SIMD_WIDTH
+
+// Arrays get CULL_WIDTH floats of slack so the last batch can load a full vector.
+static float *resize_array(float *array, int capacity) {
+	return realloc(array, (capacity + CULL_WIDTH) * sizeof(float));
+}
+
+CullSet cull_set_create(int capacity) {
+	CullSet set = {0};
+	set.capacity = capacity;
+	for (int i = 0; i < 3; i++) {
+		set.center[i] = resize_array(NULL, capacity);
+		set.extent[i] = resize_array(NULL, capacity);
+	}
+	set.radius = resize_array(NULL, capacity);
+	return set;
+}
+
+void cull_set_update_aabb(CullSet *set, int index, vec3 box[2]) {
+	for (int i = 0; i < 3; i++) {
+		set->center[i][index] = (box[0][i] + box[1][i]) * 0.5f;
+		set->extent[i][index] = (box[1][i] - box[0][i]) * 0.5f;
+	}
+	set->radius[index] = glm_aabb_radius(box);
+}
+
+// Append a box in glm_aabb layout ({min, max}). Returns its index.
+int cull_set_add_aabb(CullSet *set, vec3 box[2]) {
+	if (set->count == set->capacity) {
+		set->capacity = set->capacity ? set->capacity * 2 : 256;
+		for (int i = 0; i < 3; i++) {
+			set->center[i] = resize_array(set->center[i], set->capacity);
+			set->extent[i] = resize_array(set->extent[i], set->capacity);
+		}
+		set->radius = resize_array(set->radius, set->capacity);
+	}
+
+	cull_set_update_aabb(set, set->count, box);
+	return set->count++;
+}
+
+void cull_set_destroy(CullSet *set) {
+	for (int i = 0; i < 3; i++) {
+		free(set->center[i]);
+		free(set->extent[i]);
+	}
+	free(set->radius);
+	memset(set, 0, sizeof(*set));
+}
+
+// Test every volume against the six planes from glm_frustum_planes() and write
+// the indices of the ones at least partly inside to `visible`. A volume is outside
+// when its center is farther behind a plane than its projected radius.
+static int cull_frustum(const CullSet *set, vec4 planes[6], int *visible, int spheres) {
+	int count = 0;
+	int i = 0;
+
+#if CULL_WIDTH > 1
+	vfloat normal[6][3], abs_normal[6][3], dist[6];
+	for (int p = 0; p < 6; p++) {
+		for (int k = 0; k < 3; k++) {
+			normal[p][k] = v_set1(planes[p][k]);
+			abs_normal[p][k] = v_set1(fabsf(planes[p][k]));
+		}
+		dist[p] = v_set1(planes[p][3]);
+	}
+	vfloat zero = v_set1(0.0f);
+
+	for (; i < set->count; i += CULL_WIDTH) {
+		// The last batch may read past count into the arrays' slack.
+		vfloat cx = v_load(set->center[0] + i);
+		vfloat cy = v_load(set->center[1] + i);
+		vfloat cz = v_load(set->center[2] + i);
+		vfloat ex = zero, ey = zero, ez = zero, radius = zero;
+		if (spheres) {
+			radius = v_load(set->radius + i);
+		} else {
+			ex = v_load(set->extent[0] + i);
+			ey = v_load(set->extent[1] + i);
+			ez = v_load(set->extent[2] + i);
+		}
+
+		vfloat inside = v_true();
+		for (int p = 0; p < 6; p++) {
+			vfloat d = v_add(v_add(v_mul(normal[p][0], cx), v_mul(normal[p][1], cy)), v_add(v_mul(normal[p][2], cz), dist[p]));
+			if (!spheres) {
+				radius = v_add(v_add(v_mul(abs_normal[p][0], ex), v_mul(abs_normal[p][1], ey)), v_mul(abs_normal[p][2], ez));
+			}
+			inside = v_and(inside, v_ge(v_add(d, radius), zero));
+		}
+
+		int mask = v_movemask(inside);
+		int lanes = set->count - i < CULL_WIDTH ? set->count - i : CULL_WIDTH;
+		// Branchless compaction: always write, only advance on visible lanes.
+		for (int lane = 0; lane < lanes; lane++) {
+			visible[count] = i + lane;
+			count += (mask >> lane) & 1;
+		}
+	}
+#else
+	for (; i < set->count; i++) {
+		int inside = 1;
+		for (int p = 0; p < 6 && inside; p++) {
+			float d = planes[p][0] * set->center[0][i] + planes[p][1] * set->center[1][i] + planes[p][2] * set->center[2][i] + planes[p][3];
+			float radius = spheres ? set->radius[i] :
+				fabsf(planes[p][0]) * set->extent[0][i] + fabsf(planes[p][1]) * set->extent[1][i] + fabsf(planes[p][2]) * set->extent[2][i];
+			inside = d + radius >= 0.0f;
+		}
+		visible[count] = i;
+		count += inside;
+	}
+#endif
+
+	return count;
+}
+
+int cull_frustum_aabbs(const CullSet *set, vec4 planes[6], int *visible) {
+	return cull_frustum(set, planes, visible, 0);
+}
+
+int cull_frustum_spheres(const CullSet *set, vec4 planes[6], int *visible) {
+	return cull_frustum(set, planes, visible, 1);
+}
+
+static double elapsed_ms(Uint64 start) {
+	return (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+// Cull `count` random boxes with glm_aabb_frustum one at a time and with the
+// batched SoA path, and print both timings.
+void cull_benchmark(int count) {
+	const int runs = 20;
+	vec3 (*boxes)[2] = malloc(count * sizeof(*boxes));
+	CullSet set = cull_set_create(count);
+	srand(1);
+	for (int i = 0; i < count; i++) {
+		vec3 center = {rand() % 2000 / 10.0f - 100.0f, rand() % 2000 / 10.0f - 100.0f, rand() % 2000 / 10.0f - 100.0f};
+		float size = 0.5f + rand() % 100 / 50.0f;
+		glm_vec3_subs(center, size, boxes[i][0]);
+		glm_vec3_adds(center, size, boxes[i][1]);
+		cull_set_add_aabb(&set, boxes[i]);
+	}
+
+	// Camera at the origin looking down -z.
+	mat4 view, proj, view_proj;
+	vec4 planes[6];
+	glm_lookat((vec3){0.0f, 0.0f, 0.0f}, (vec3){0.0f, 0.0f, -1.0f}, (vec3){0.0f, 1.0f, 0.0f}, view);
+	glm_perspective(glm_rad(60.0f), 1.0f, 0.1f, 100.0f, proj);
+	glm_mat4_mul(proj, view, view_proj);
+	glm_frustum_planes(view_proj, planes);
+
+	int *visible = malloc(count * sizeof(int));
+	int scalar_visible = 0;
+	Uint64 start = SDL_GetPerformanceCounter();
+	for (int run = 0; run < runs; run++) {
+		scalar_visible = 0;
+		for (int i = 0; i < count; i++) {
+			if (glm_aabb_frustum(boxes[i], planes)) {
+				visible[scalar_visible++] = i;
+			}
+		}
+	}
+	double scalar_ms = elapsed_ms(start) / runs;
+
+	int aabb_visible = 0;
+	start = SDL_GetPerformanceCounter();
+	for (int run = 0; run < runs; run++) {
+		aabb_visible = cull_frustum_aabbs(&set, planes, visible);
+	}
+	double aabb_ms = elapsed_ms(start) / runs;
+
+	int sphere_visible = 0;
+	start = SDL_GetPerformanceCounter();
+	for (int run = 0; run < runs; run++) {
+		sphere_visible = cull_frustum_spheres(&set, planes, visible);
+	}
+	double sphere_ms = elapsed_ms(start) / runs;
+
+	printf("Frustum culling benchmark, %d objects, %d lanes:\n", count, CULL_WIDTH);
+	printf("  glm_aabb_frustum: %8.3f ms (%d visible)\n", scalar_ms, scalar_visible);
+	printf("  SoA AABBs:        %8.3f ms (%d visible)\n", aabb_ms, aabb_visible);
+	printf("  SoA spheres:      %8.3f ms (%d visible)\n", sphere_ms, sphere_visible);
+
+	// Cleanup.
+	free(visible);
+	free(boxes);
+	cull_set_destroy(&set);
+}
@@ -0,0 +1,25 @@
+#ifndef CULL_H
+#define CULL_H
+
+#include <cglm/cglm.h>
+
+// Bounding volumes in structure of arrays form, so one SIMD load covers the same
+// component of 4 (SSE2/NEON) or 8 (AVX) objects.
+typedef struct {
+	float *center[3];
+	float *extent[3]; // AABB half size.
+	float *radius;    // Bounding sphere around the AABB.
+	int count;
+	int capacity;
+} CullSet;
+
+CullSet cull_set_create(int capacity);
+int cull_set_add_aabb(CullSet *set, vec3 box[2]);
+void cull_set_update_aabb(CullSet *set, int index, vec3 box[2]);
+void cull_set_destroy(CullSet *set);
+
+int cull_frustum_aabbs(const CullSet *set, vec4 planes[6], int *visible);
+int cull_frustum_spheres(const CullSet *set, vec4 planes[6], int *visible);
+void cull_benchmark(int count);
+
+#endif
@@ -0,0 +1,27 @@
+#include <glad/glad.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fullscreen.h"
+#include "shader.h"
+
+// `vertex_source` is NULL if `vertex_path` could not be loaded.
+FullscreenPass fullscreen_create(const char *vertex_path) {
+	FullscreenPass pass = {0};
+	pass.vertex_source = shader_source_load(vertex_path, NULL);
+	glGenVertexArrays(1, &pass.vao);
+	return pass;
+}
+
+// Draw the triangle with whatever program is bound, without depth testing.
+void fullscreen_draw(const FullscreenPass *pass) {
+	glDisable(GL_DEPTH_TEST);
+	glBindVertexArray(pass->vao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glEnable(GL_DEPTH_TEST);
+}
+
+void fullscreen_destroy(FullscreenPass *pass) {
+	glDeleteVertexArrays(1, &pass->vao);
+	free(pass->vertex_source);
+	memset(pass, 0, sizeof(*pass));
+}
@@ -0,0 +1,15 @@
+#ifndef FULLSCREEN_H
+#define FULLSCREEN_H
+
+// One triangle covering the screen, for passes that shade every pixel. The
+// vertex shader, shaders/fullscreen.vert, builds it from gl_VertexID.
+typedef struct {
+	unsigned int vao; // Empty; the core profile needs one bound to draw.
+	char *vertex_source;
+} FullscreenPass;
+
+FullscreenPass fullscreen_create(const char *vertex_path);
+void fullscreen_draw(const FullscreenPass *pass);
+void fullscreen_destroy(FullscreenPass *pass);
+
+#endif
@@ -0,0 +1,91 @@
+#include <glad/glad.h>
+#include <stdio.h>
+#include <string.h>
+#include "gbuffer.h"
+
+GBuffer gbuffer_create(const FullscreenPass *fullscreen) {
+	GBuffer gbuffer = {0};
+	gbuffer.fullscreen = fullscreen;
+	glGenFramebuffers(1, &gbuffer.fbo);
+	glGenTextures(1, &gbuffer.albedo);
+	glGenTextures(1, &gbuffer.normal);
+	glGenTextures(1, &gbuffer.depth);
+	return gbuffer;
+}
+
+// Point the resolve program's samplers at the G-buffer units. Programs not
+// reading the G-buffer pass untouched.
+int gbuffer_bind_program(const ShaderProgram *program) {
+	const char *names[3] = {"gbuffer_albedo", "gbuffer_normal", "gbuffer_depth"};
+	const int units[3] = {GBUFFER_UNIT_ALBEDO, GBUFFER_UNIT_NORMAL, GBUFFER_UNIT_DEPTH};
+	int found = 0;
+	for (int i = 0; i < program->uniform_count; i++) {
+		found |= strncmp(program->uniforms[i].name, "gbuffer_", 8) == 0;
+	}
+	if (!found) {
+		return 1;
+	}
+
+	glUseProgram(program->id);
+	for (int i = 0; i < 3; i++) {
+		UniformHandle sampler = shader_uniform(program, names[i], GL_SAMPLER_2D);
+		if (sampler.location < 0) {
+			return 0;
+		}
+		shader_set_int(sampler, units[i]);
+	}
+	return 1;
+}
+
+static void texture_storage(unsigned int texture, GLint format, GLenum data_format, GLenum type, int width, int height) {
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, data_format, type, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+// Redirect the geometry pass to the G-buffer, sized to match the window. The
+// caller clears it.
+void gbuffer_begin(GBuffer *gbuffer, int width, int height) {
+	if (width != gbuffer->width || height != gbuffer->height) {
+		gbuffer->width = width;
+		gbuffer->height = height;
+		texture_storage(gbuffer->albedo, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height);
+		texture_storage(gbuffer->normal, GL_RG16, GL_RG, GL_UNSIGNED_SHORT, width, height);
+		texture_storage(gbuffer->depth, GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, width, height);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, gbuffer->fbo);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gbuffer->albedo, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gbuffer->normal, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, gbuffer->depth, 0);
+		const GLenum buffers[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+		glDrawBuffers(2, buffers);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			printf("G-buffer framebuffer incomplete\n");
+		}
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, gbuffer->fbo);
+}
+
+// Light every covered pixel with `program`, a fullscreen pass into the `output`
+// framebuffer. The cluster buffers must be bound, see clusters_upload().
+void gbuffer_resolve(GBuffer *gbuffer, unsigned int program, unsigned int output) {
+	glBindFramebuffer(GL_FRAMEBUFFER, output);
+	glUseProgram(program);
+	glActiveTexture(GL_TEXTURE0 + GBUFFER_UNIT_ALBEDO);
+	glBindTexture(GL_TEXTURE_2D, gbuffer->albedo);
+	glActiveTexture(GL_TEXTURE0 + GBUFFER_UNIT_NORMAL);
+	glBindTexture(GL_TEXTURE_2D, gbuffer->normal);
+	glActiveTexture(GL_TEXTURE0 + GBUFFER_UNIT_DEPTH);
+	glBindTexture(GL_TEXTURE_2D, gbuffer->depth);
+	glActiveTexture(GL_TEXTURE0);
+	fullscreen_draw(gbuffer->fullscreen);
+}
+
+void gbuffer_destroy(GBuffer *gbuffer) {
+	unsigned int textures[3] = {gbuffer->albedo, gbuffer->normal, gbuffer->depth};
+	glDeleteFramebuffers(1, &gbuffer->fbo);
+	glDeleteTextures(3, textures);
+	memset(gbuffer, 0, sizeof(*gbuffer));
+}
@@ -0,0 +1,30 @@
+#ifndef GBUFFER_H
+#define GBUFFER_H
+
+#include "fullscreen.h"
+#include "shader.h"
+
+// Texture units the resolve pass reads the G-buffer from, past the cluster ones.
+#define GBUFFER_UNIT_ALBEDO 4
+#define GBUFFER_UNIT_NORMAL 5
+#define GBUFFER_UNIT_DEPTH 6
+
+// Deferred shading target, 8 bytes per pixel plus depth. Positions are rebuilt
+// from depth, normals are octahedral encoded, see shaders/gbuffer.glsl. Lights
+// are accumulated in one fullscreen pass over the clustered light lists.
+typedef struct {
+	unsigned int fbo;
+	unsigned int albedo; // GL_RGBA8, specular strength in alpha.
+	unsigned int normal; // GL_RG16.
+	unsigned int depth;  // GL_DEPTH_COMPONENT24 texture.
+	int width, height;
+	const FullscreenPass *fullscreen;
+} GBuffer;
+
+GBuffer gbuffer_create(const FullscreenPass *fullscreen);
+int gbuffer_bind_program(const ShaderProgram *program);
+void gbuffer_begin(GBuffer *gbuffer, int width, int height);
+void gbuffer_resolve(GBuffer *gbuffer, unsigned int program, unsigned int output);
+void gbuffer_destroy(GBuffer *gbuffer);
+
+#endif
@@ -0,0 +1,428 @@
+#include <glad/glad.h>
+#include <stdio.h>
+#include <string.h>
+#include "gl_state.h"
+
+// Shadow copy of the GL state the renderer touches. gl_state_init() swaps glad's
+// function pointers for filters that skip calls which would not change it, so
+// every existing call site goes through the cache without changes.
+
+#define UNKNOWN 0xffffffffu
+#define MAX_TEXTURE_UNITS 32
+#define MAX_UNIFORM_BINDINGS 16
+#define MAX_CAPS 8
+
+static const char *kind_names[GL_STATE_COUNT] = {
+	"program", "vao", "buffer", "texture", "sampler", "framebuffer",
+	"enable", "blend", "depth", "raster", "viewport"
+};
+
+// Texture targets with their own binding per unit.
+static const GLenum texture_targets[] = {
+	GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_3D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BUFFER
+};
+#define TEXTURE_TARGET_COUNT (sizeof(texture_targets) / sizeof(texture_targets[0]))
+
+// Capabilities toggled with glEnable/glDisable.
+static const GLenum caps[MAX_CAPS] = {
+	GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE, GL_SCISSOR_TEST,
+	GL_STENCIL_TEST, GL_POLYGON_OFFSET_FILL, GL_DEPTH_CLAMP, GL_FRAMEBUFFER_SRGB
+};
+
+typedef struct {
+	unsigned int buffer;
+	GLintptr offset;
+	GLsizeiptr size; // -1 for a whole buffer binding.
+} IndexedBinding;
+
+static struct {
+	unsigned int program;
+	unsigned int vao;
+	unsigned int array_buffer;
+	unsigned int uniform_buffer;
+	IndexedBinding uniform_bindings[MAX_UNIFORM_BINDINGS];
+	unsigned int active_texture; // Unit index, not GL_TEXTUREi.
+	unsigned int textures[MAX_TEXTURE_UNITS][TEXTURE_TARGET_COUNT];
+	unsigned int samplers[MAX_TEXTURE_UNITS];
+	unsigned int draw_framebuffer, read_framebuffer;
+	int caps[MAX_CAPS]; // -1 unknown.
+	GLenum blend_src_rgb, blend_dst_rgb, blend_src_alpha, blend_dst_alpha;
+	GLenum blend_equation;
+	GLenum depth_func;
+	int depth_mask;
+	int color_mask[4];
+	GLenum cull_face, front_face;
+	int viewport[4];
+} state;
+
+
+static GlStateCounter counters[GL_STATE_COUNT];
+static GlStateCounter last_frame[GL_STATE_COUNT];
+
+// Original glad entrypoints.
+static PFNGLUSEPROGRAMPROC real_use_program;
+static PFNGLBINDVERTEXARRAYPROC real_bind_vertex_array;
+static PFNGLBINDBUFFERPROC real_bind_buffer;
+static PFNGLBINDBUFFERBASEPROC real_bind_buffer_base;
+static PFNGLBINDBUFFERRANGEPROC real_bind_buffer_range;
+static PFNGLACTIVETEXTUREPROC real_active_texture;
+static PFNGLBINDTEXTUREPROC real_bind_texture;
+static PFNGLBINDSAMPLERPROC real_bind_sampler;
+static PFNGLBINDFRAMEBUFFERPROC real_bind_framebuffer;
+static PFNGLENABLEPROC real_enable;
+static PFNGLDISABLEPROC real_disable;
+static PFNGLBLENDFUNCPROC real_blend_func;
+static PFNGLBLENDFUNCSEPARATEPROC real_blend_func_separate;
+static PFNGLBLENDEQUATIONPROC real_blend_equation;
+static PFNGLDEPTHFUNCPROC real_depth_func;
+static PFNGLDEPTHMASKPROC real_depth_mask;
+static PFNGLCOLORMASKPROC real_color_mask;
+static PFNGLCULLFACEPROC real_cull_face;
+static PFNGLFRONTFACEPROC real_front_face;
+static PFNGLVIEWPORTPROC real_viewport;
+static PFNGLDELETEPROGRAMPROC real_delete_program;
+static PFNGLDELETEVERTEXARRAYSPROC real_delete_vertex_arrays;
+static PFNGLDELETEBUFFERSPROC real_delete_buffers;
+static PFNGLDELETETEXTURESPROC real_delete_textures;
+static PFNGLDELETESAMPLERSPROC real_delete_samplers;
+static PFNGLDELETEFRAMEBUFFERSPROC real_delete_framebuffers;
+
+// Count the call and return from the filter if it would not change anything.
+#define FILTER(kind, unchanged) do { \
+	if (unchanged) { counters[kind].elided++; return; } \
+	counters[kind].issued++; \
+} while (0)
+
+static void APIENTRY filtered_use_program(GLuint program) {
+	FILTER(GL_STATE_PROGRAM, state.program == program);
+	state.program = program;
+	real_use_program(program);
+}
+
+static void APIENTRY filtered_bind_vertex_array(GLuint vao) {
+	FILTER(GL_STATE_VAO, state.vao == vao);
+	state.vao = vao;
+	real_bind_vertex_array(vao);
+}
+
+static void APIENTRY filtered_bind_buffer(GLenum target, GLuint buffer) {
+	// GL_ELEMENT_ARRAY_BUFFER is VAO state, so it always goes through.
+	if (target == GL_ARRAY_BUFFER) {
+		FILTER(GL_STATE_BUFFER, state.array_buffer == buffer);
+		state.array_buffer = buffer;
+	} else if (target == GL_UNIFORM_BUFFER) {
+		FILTER(GL_STATE_BUFFER, state.uniform_buffer == buffer);
+		state.uniform_buffer = buffer;
+	} else {
+		counters[GL_STATE_BUFFER].issued++;
+	}
+	real_bind_buffer(target, buffer);
+}
+
+static void APIENTRY filtered_bind_buffer_range(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+	if (target == GL_UNIFORM_BUFFER && index < MAX_UNIFORM_BINDINGS) {
+		IndexedBinding *binding = &state.uniform_bindings[index];
+		FILTER(GL_STATE_BUFFER, binding->buffer == buffer && binding->offset == offset && binding->size == size);
+		binding->buffer = buffer;
+		binding->offset = offset;
+		binding->size = size;
+		state.uniform_buffer = buffer; // Indexed binds also change the generic binding.
+	} else {
+		counters[GL_STATE_BUFFER].issued++;
+	}
+	real_bind_buffer_range(target, index, buffer, offset, size);
+}
+
+static void APIENTRY filtered_bind_buffer_base(GLenum target, GLuint index, GLuint buffer) {
+	if (target == GL_UNIFORM_BUFFER && index < MAX_UNIFORM_BINDINGS) {
+		IndexedBinding *binding = &state.uniform_bindings[index];
+		FILTER(GL_STATE_BUFFER, binding->buffer == buffer && binding->offset == 0 && binding->size == -1);
+		binding->buffer = buffer;
+		binding->offset = 0;
+		binding->size = -1;
+		state.uniform_buffer = buffer;
+	} else {
+		counters[GL_STATE_BUFFER].issued++;
+	}
+	real_bind_buffer_base(target, index, buffer);
+}
+
+static void APIENTRY filtered_active_texture(GLenum texture) {
+	unsigned int unit = texture - GL_TEXTURE0;
+	FILTER(GL_STATE_TEXTURE, state.active_texture == unit);
+	state.active_texture = unit;
+	real_active_texture(texture);
+}
+
+static void APIENTRY filtered_bind_texture(GLenum target, GLuint texture) {
+	for (unsigned int i = 0; i < TEXTURE_TARGET_COUNT; i++) {
+		if (texture_targets[i] == target && state.active_texture < MAX_TEXTURE_UNITS) {
+			unsigned int *bound = &state.textures[state.active_texture][i];
+			FILTER(GL_STATE_TEXTURE, *bound == texture);
+			*bound = texture;
+			real_bind_texture(target, texture);
+			return;
+		}
+	}
+	counters[GL_STATE_TEXTURE].issued++;
+	real_bind_texture(target, texture);
+}
+
+static void APIENTRY filtered_bind_sampler(GLuint unit, GLuint sampler) {
+	if (unit < MAX_TEXTURE_UNITS) {
+		FILTER(GL_STATE_SAMPLER, state.samplers[unit] == sampler);
+		state.samplers[unit] = sampler;
+	} else {
+		counters[GL_STATE_SAMPLER].issued++;
+	}
+	real_bind_sampler(unit, sampler);
+}
+
+static void APIENTRY filtered_bind_framebuffer(GLenum target, GLuint framebuffer) {
+	if (target == GL_FRAMEBUFFER) {
+		FILTER(GL_STATE_FRAMEBUFFER, state.draw_framebuffer == framebuffer && state.read_framebuffer == framebuffer);
+		state.draw_framebuffer = state.read_framebuffer = framebuffer;
+	} else if (target == GL_DRAW_FRAMEBUFFER) {
+		FILTER(GL_STATE_FRAMEBUFFER, state.draw_framebuffer == framebuffer);
+		state.draw_framebuffer = framebuffer;
+	} else {
+		FILTER(GL_STATE_FRAMEBUFFER, state.read_framebuffer == framebuffer);
+		state.read_framebuffer = framebuffer;
+	}
+	real_bind_framebuffer(target, framebuffer);
+}
+
+static int cap_index(GLenum cap) {
+	for (int i = 0; i < MAX_CAPS; i++) {
+		if (caps[i] == cap) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+static void APIENTRY filtered_enable(GLenum cap) {
+	int i = cap_index(cap);
+	if (i >= 0) {
+		FILTER(GL_STATE_ENABLE, state.caps[i] == 1);
+		state.caps[i] = 1;
+	} else {
+		counters[GL_STATE_ENABLE].issued++;
+	}
+	real_enable(cap);
+}
+
+static void APIENTRY filtered_disable(GLenum cap) {
+	int i = cap_index(cap);
+	if (i >= 0) {
+		FILTER(GL_STATE_ENABLE, state.caps[i] == 0);
+		state.caps[i] = 0;
+	} else {
+		counters[GL_STATE_ENABLE].issued++;
+	}
+	real_disable(cap);
+}
+
+static void APIENTRY filtered_blend_func_separate(GLenum src_rgb, GLenum dst_rgb, GLenum src_alpha, GLenum dst_alpha) {
+	FILTER(GL_STATE_BLEND, state.blend_src_rgb == src_rgb && state.blend_dst_rgb == dst_rgb &&
+		state.blend_src_alpha == src_alpha && state.blend_dst_alpha == dst_alpha);
+	state.blend_src_rgb = src_rgb;
+	state.blend_dst_rgb = dst_rgb;
+	state.blend_src_alpha = src_alpha;
+	state.blend_dst_alpha = dst_alpha;
+	real_blend_func_separate(src_rgb, dst_rgb, src_alpha, dst_alpha);
+}
+
+static void APIENTRY filtered_blend_func(GLenum src, GLenum dst) {
+	FILTER(GL_STATE_BLEND, state.blend_src_rgb == src && state.blend_dst_rgb == dst &&
+		state.blend_src_alpha == src && state.blend_dst_alpha == dst);
+	state.blend_src_rgb = state.blend_src_alpha = src;
+	state.blend_dst_rgb = state.blend_dst_alpha = dst;
+	real_blend_func(src, dst);
+}
+
+static void APIENTRY filtered_blend_equation(GLenum mode) {
+	FILTER(GL_STATE_BLEND, state.blend_equation == mode);
+	state.blend_equation = mode;
+	real_blend_equation(mode);
+}
+
+static void APIENTRY filtered_depth_func(GLenum func) {
+	FILTER(GL_STATE_DEPTH, state.depth_func == func);
+	state.depth_func = func;
+	real_depth_func(func);
+}
+
+static void APIENTRY filtered_depth_mask(GLboolean flag) {
+	FILTER(GL_STATE_DEPTH, state.depth_mask == flag);
+	state.depth_mask = flag;
+	real_depth_mask(flag);
+}
+
+static void APIENTRY filtered_color_mask(GLboolean r, GLboolean g, GLboolean b, GLboolean a) {
+	FILTER(GL_STATE_RASTER, state.color_mask[0] == r && state.color_mask[1] == g &&
+		state.color_mask[2] == b && state.color_mask[3] == a);
+	state.color_mask[0] = r;
+	state.color_mask[1] = g;
+	state.color_mask[2] = b;
+	state.color_mask[3] = a;
+	real_color_mask(r, g, b, a);
+}
+
+static void APIENTRY filtered_cull_face(GLenum mode) {
+	FILTER(GL_STATE_RASTER, state.cull_face == mode);
+	state.cull_face = mode;
+	real_cull_face(mode);
+}
+
+static void APIENTRY filtered_front_face(GLenum mode) {
+	FILTER(GL_STATE_RASTER, state.front_face == mode);
+	state.front_face = mode;
+	real_front_face(mode);
+}
+
+static void APIENTRY filtered_viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+	FILTER(GL_STATE_VIEWPORT, state.viewport[0] == x && state.viewport[1] == y &&
+		state.viewport[2] == width && state.viewport[3] == height);
+	state.viewport[0] = x;
+	state.viewport[1] = y;
+	state.viewport[2] = width;
+	state.viewport[3] = height;
+	real_viewport(x, y, width, height);
+}
+
+// Deleting a bound object unbinds it, and GL may hand its name out again.
+static void APIENTRY filtered_delete_program(GLuint program) {
+	if (state.program == program) {
+		state.program = UNKNOWN;
+	}
+	real_delete_program(program);
+}
+
+static void APIENTRY filtered_delete_vertex_arrays(GLsizei n, const GLuint *arrays) {
+	for (int i = 0; i < n; i++) {
+		if (state.vao == arrays[i]) {
+			state.vao = 0;
+		}
+	}
+	real_delete_vertex_arrays(n, arrays);
+}
+
+static void APIENTRY filtered_delete_buffers(GLsizei n, const GLuint *buffers) {
+	for (int i = 0; i < n; i++) {
+		if (state.array_buffer == buffers[i]) {
+			state.array_buffer = 0;
+		}
+		if (state.uniform_buffer == buffers[i]) {
+			state.uniform_buffer = 0;
+		}
+		for (int j = 0; j < MAX_UNIFORM_BINDINGS; j++) {
+			if (state.uniform_bindings[j].buffer == buffers[i]) {
+				state.uniform_bindings[j].buffer = 0;
+			}
+		}
+	}
+	real_delete_buffers(n, buffers);
+}
+
+static void APIENTRY filtered_delete_textures(GLsizei n, const GLuint *textures) {
+	for (int i = 0; i < n; i++) {
+		for (int unit = 0; unit < MAX_TEXTURE_UNITS; unit++) {
+			for (unsigned int t = 0; t < TEXTURE_TARGET_COUNT; t++) {
+				if (state.textures[unit][t] == textures[i]) {
+					state.textures[unit][t] = 0;
+				}
+			}
+		}
+	}
+	real_delete_textures(n, textures);
+}
+
+static void APIENTRY filtered_delete_samplers(GLsizei n, const GLuint *samplers) {
+	for (int i = 0; i < n; i++) {
+		for (int unit = 0; unit < MAX_TEXTURE_UNITS; unit++) {
+			if (state.samplers[unit] == samplers[i]) {
+				state.samplers[unit] = 0;
+			}
+		}
+	}
+	real_delete_samplers(n, samplers);
+}
+
+static void APIENTRY filtered_delete_framebuffers(GLsizei n, const GLuint *framebuffers) {
+	for (int i = 0; i < n; i++) {
+		if (state.draw_framebuffer == framebuffers[i]) {
+			state.draw_framebuffer = 0;
+		}
+		if (state.read_framebuffer == framebuffers[i]) {
+			state.read_framebuffer = 0;
+		}
+	}
+	real_delete_framebuffers(n, framebuffers);
+}
+
+// Install the filters over glad's entrypoints. Call once, right after gladLoadGLLoader().
+void gl_state_init(void) {
+#define WRAP(name, real, filtered) real = glad_##name; glad_##name = filtered
+	WRAP(glUseProgram, real_use_program, filtered_use_program);
+	WRAP(glBindVertexArray, real_bind_vertex_array, filtered_bind_vertex_array);
+	WRAP(glBindBuffer, real_bind_buffer, filtered_bind_buffer);
+	WRAP(glBindBufferBase, real_bind_buffer_base, filtered_bind_buffer_base);
+	WRAP(glBindBufferRange, real_bind_buffer_range, filtered_bind_buffer_range);
+	WRAP(glActiveTexture, real_active_texture, filtered_active_texture);
+	WRAP(glBindTexture, real_bind_texture, filtered_bind_texture);
+	WRAP(glBindSampler, real_bind_sampler, filtered_bind_sampler);
+	WRAP(glBindFramebuffer, real_bind_framebuffer, filtered_bind_framebuffer);
+	WRAP(glEnable, real_enable, filtered_enable);
+	WRAP(glDisable, real_disable, filtered_disable);
+	WRAP(glBlendFunc, real_blend_func, filtered_blend_func);
+	WRAP(glBlendFuncSeparate, real_blend_func_separate, filtered_blend_func_separate);
+	WRAP(glBlendEquation, real_blend_equation, filtered_blend_equation);
+	WRAP(glDepthFunc, real_depth_func, filtered_depth_func);
+	WRAP(glDepthMask, real_depth_mask, filtered_depth_mask);
+	WRAP(glColorMask, real_color_mask, filtered_color_mask);
+	WRAP(glCullFace, real_cull_face, filtered_cull_face);
+	WRAP(glFrontFace, real_front_face, filtered_front_face);
+	WRAP(glViewport, real_viewport, filtered_viewport);
+	WRAP(glDeleteProgram, real_delete_program, filtered_delete_program);
+	WRAP(glDeleteVertexArrays, real_delete_vertex_arrays, filtered_delete_vertex_arrays);
+	WRAP(glDeleteBuffers, real_delete_buffers, filtered_delete_buffers);
+	WRAP(glDeleteTextures, real_delete_textures, filtered_delete_textures);
+	WRAP(glDeleteSamplers, real_delete_samplers, filtered_delete_samplers);
+	WRAP(glDeleteFramebuffers, real_delete_framebuffers, filtered_delete_framebuffers);
+#undef WRAP
+
+	gl_state_invalidate();
+}
+
+// Forget everything, so the next call of each kind reaches the driver. Needed
+// after code that bypasses the filters changed GL state.
+void gl_state_invalidate(void) {
+	memset(&state, 0xff, sizeof(state));
+	for (int i = 0; i < MAX_CAPS; i++) {
+		state.caps[i] = -1;
+	}
+	state.depth_mask = -1;
+	for (int i = 0; i < 4; i++) {
+		state.color_mask[i] = -1;
+		state.viewport[i] = -1;
+	}
+}
+
+// Keep this frame's counters for gl_state_counters() and start counting the next.
+void gl_state_end_frame(void) {
+	memcpy(last_frame, counters, sizeof(counters));
+	memset(counters, 0, sizeof(counters));
+}
+
+// Counters of the last finished frame, indexed by GlStateKind.
+const GlStateCounter *gl_state_counters(void) {
+	return last_frame;
+}
+
+void gl_state_report(void) {
+	printf("GL state changes last frame: (issued / elided)\n");
+	for (int i = 0; i < GL_STATE_COUNT; i++) {
+		printf("  %-12s %6d / %6d\n", kind_names[i], last_frame[i].issued, last_frame[i].elided);
+	}
+}
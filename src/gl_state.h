@@ -0,0 +1,31 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+// Kinds of state changes the shadow state filters.
+typedef enum {
+	GL_STATE_PROGRAM,
+	GL_STATE_VAO,
+	GL_STATE_BUFFER,
+	GL_STATE_TEXTURE,
+	GL_STATE_SAMPLER,
+	GL_STATE_FRAMEBUFFER,
+	GL_STATE_ENABLE,
+	GL_STATE_BLEND,
+	GL_STATE_DEPTH,
+	GL_STATE_RASTER,
+	GL_STATE_VIEWPORT,
+	GL_STATE_COUNT
+} GlStateKind;
+
+typedef struct {
+	int issued; // Calls that reached the driver.
+	int elided; // Calls dropped because they would not change anything.
+} GlStateCounter;
+
+void gl_state_init(void);
+void gl_state_invalidate(void);
+void gl_state_end_frame(void);
+const GlStateCounter *gl_state_counters(void);
+void gl_state_report(void);
+
+#endif
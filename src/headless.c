@@ -0,0 +1,55 @@
+#include <glad/glad.h>
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "headless.h"
+#include "ppm.h"
+
+// Pick the offscreen video driver. Call before SDL_Init().
+void headless_init(void) {
+	SDL_SetHint(SDL_HINT_VIDEODRIVER, "offscreen");
+}
+
+// Create the target, left bound. Passes that end on the screen are given its
+// `fbo` as their output instead of framebuffer 0.
+HeadlessTarget headless_create(int width, int height) {
+	HeadlessTarget target = {0};
+	target.width = width;
+	target.height = height;
+	target.pixels = malloc((size_t)width * height * 4);
+
+	glGenRenderbuffers(1, &target.color);
+	glBindRenderbuffer(GL_RENDERBUFFER, target.color);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glGenRenderbuffers(1, &target.depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, target.depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &target.fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target.color);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target.depth);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		printf("Headless framebuffer incomplete\n");
+	}
+	return target;
+}
+
+// Write the current contents as a binary PPM, top row first. Blocks until the
+// frame is done. Returns 0 if the file could not be written.
+int headless_write_ppm(HeadlessTarget *target, const char *path) {
+	glBindFramebuffer(GL_FRAMEBUFFER, target->fbo);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, target->width, target->height, GL_RGB, GL_UNSIGNED_BYTE, target->pixels);
+	return ppm_write(path, target->width, target->height, target->pixels, (size_t)target->width * 3, 1);
+}
+
+void headless_destroy(HeadlessTarget *target) {
+	unsigned int renderbuffers[2] = {target->color, target->depth};
+	glDeleteFramebuffers(1, &target->fbo);
+	glDeleteRenderbuffers(2, renderbuffers);
+	free(target->pixels);
+	memset(target, 0, sizeof(*target));
+}
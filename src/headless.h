@@ -0,0 +1,22 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#define HEADLESS_FRAME_MS 16 // Animation time between headless frames.
+
+// Render target standing in for the window's framebuffer when there is no
+// display: SDL's offscreen video driver gives an EGL context (surfaceless on
+// Mesa) without a default framebuffer, so frames go to this FBO instead.
+typedef struct {
+	unsigned int fbo;
+	unsigned int color; // GL_RGBA8 renderbuffer.
+	unsigned int depth; // GL_DEPTH_COMPONENT24 renderbuffer.
+	int width, height;
+	unsigned char *pixels; // Readback scratch for PPM dumps.
+} HeadlessTarget;
+
+void headless_init(void);
+HeadlessTarget headless_create(int width, int height);
+int headless_write_ppm(HeadlessTarget *target, const char *path);
+void headless_destroy(HeadlessTarget *target);
+
+#endif
@@ -0,0 +1,122 @@
+#include <glad/glad.h>
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "instance.h"
+
+InstanceBuffer instance_buffer_create(int capacity) {
+	InstanceBuffer instances = {0};
+	instances.capacity = capacity;
+
+	glGenBuffers(1, &instances.vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, instances.vbo);
+	glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(mat4), NULL, GL_STREAM_DRAW);
+	return instances;
+}
+
+// Point the per-instance attributes of a mesh's VAO at this buffer.
+void instance_buffer_attach(const InstanceBuffer *instances, const Mesh *mesh) {
+	glBindVertexArray(mesh->vao);
+	glBindBuffer(GL_ARRAY_BUFFER, instances->vbo);
+
+	// A mat4 attribute takes four consecutive vec4 locations, one per column.
+	for (int i = 0; i < 4; i++) {
+		glVertexAttribPointer(INSTANCE_ATTRIB_MODEL + i, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void*)(i * sizeof(vec4)));
+		glEnableVertexAttribArray(INSTANCE_ATTRIB_MODEL + i);
+		glVertexAttribDivisor(INSTANCE_ATTRIB_MODEL + i, 1); // Advance once per instance.
+	}
+
+	glBindVertexArray(0);
+}
+
+void instance_buffer_update(InstanceBuffer *instances, mat4 *models, int count) {
+	glBindBuffer(GL_ARRAY_BUFFER, instances->vbo);
+	if (count > instances->capacity) {
+		instances->capacity = count;
+	}
+
+	// Orphan the old storage so the driver doesn't wait on draws still reading it.
+	glBufferData(GL_ARRAY_BUFFER, instances->capacity * sizeof(mat4), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(mat4), models);
+	instances->count = count;
+}
+
+void instance_buffer_destroy(InstanceBuffer *instances) {
+	glDeleteBuffers(1, &instances->vbo);
+	instances->vbo = 0;
+	instances->capacity = 0;
+	instances->count = 0;
+}
+
+void instance_draw(const Mesh *mesh, const InstanceBuffer *instances) {
+	glBindVertexArray(mesh->vao);
+	glDrawElementsInstanced(GL_TRIANGLES, mesh->index_count, GL_UNSIGNED_INT, (void*)0, instances->count);
+}
+
+// Milliseconds since `start`, waiting for the GPU to finish first.
+static double elapsed_ms(Uint64 start) {
+	glFinish();
+	return (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+// Draw `count` copies of a mesh with one instanced call, then with one draw call per
+// object, and print the average frame time of both.
+void instance_benchmark(const Mesh *mesh, unsigned int shader_program, int count, int frames) {
+	// Small cubes spread over a grid in front of the camera.
+	mat4 *models = malloc(count * sizeof(mat4));
+	int side = (int)ceil(cbrt(count));
+	float scale = 1.0f / side;
+	for (int i = 0; i < count; i++) {
+		vec3 pos = {
+			(i % side) * scale - 0.5f,
+			(i / side % side) * scale - 0.5f,
+			(i / (side * side)) * scale - 0.5f
+		};
+		glm_translate_make(models[i], pos);
+		glm_scale_uni(models[i], scale * 0.5f);
+	}
+
+	InstanceBuffer instances = instance_buffer_create(count);
+	instance_buffer_attach(&instances, mesh);
+	instance_buffer_update(&instances, models, count);
+	glUseProgram(shader_program);
+
+	// Instanced: one call per frame.
+	glFinish();
+	Uint64 start = SDL_GetPerformanceCounter();
+	for (int frame = 0; frame < frames; frame++) {
+		glClear(GL_COLOR_BUFFER_BIT);
+		instance_draw(mesh, &instances);
+	}
+	double instanced_ms = elapsed_ms(start) / frames;
+
+	// Per object: the model matrix is set as a constant attribute before each draw.
+	glBindVertexArray(mesh->vao);
+	for (int i = 0; i < 4; i++) {
+		glDisableVertexAttribArray(INSTANCE_ATTRIB_MODEL + i);
+	}
+	glFinish();
+	start = SDL_GetPerformanceCounter();
+	for (int frame = 0; frame < frames; frame++) {
+		glClear(GL_COLOR_BUFFER_BIT);
+		for (int object = 0; object < count; object++) {
+			for (int i = 0; i < 4; i++) {
+				glVertexAttrib4fv(INSTANCE_ATTRIB_MODEL + i, models[object][i]);
+			}
+			glDrawElements(GL_TRIANGLES, mesh->index_count, GL_UNSIGNED_INT, (void*)0);
+		}
+	}
+	double per_object_ms = elapsed_ms(start) / frames;
+
+	printf("Instancing benchmark, %d objects, %d frames:\n", count, frames);
+	printf("  instanced:  %8.3f ms/frame (1 draw call)\n", instanced_ms);
+	printf("  per object: %8.3f ms/frame (%d draw calls)\n", per_object_ms, count);
+
+	// Cleanup.
+	for (int i = 0; i < 4; i++) {
+		glEnableVertexAttribArray(INSTANCE_ATTRIB_MODEL + i);
+	}
+	glBindVertexArray(0);
+	instance_buffer_destroy(&instances);
+	free(models);
+}
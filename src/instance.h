@@ -0,0 +1,25 @@
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include <cglm/cglm.h>
+#include "mesh.h"
+
+// First of the four attribute locations holding the per-instance model matrix.
+#define INSTANCE_ATTRIB_MODEL 1
+
+// Per-instance model matrices streamed to a VBO read with glVertexAttribDivisor.
+typedef struct {
+	unsigned int vbo;
+	int capacity;
+	int count;
+} InstanceBuffer;
+
+InstanceBuffer instance_buffer_create(int capacity);
+void instance_buffer_attach(const InstanceBuffer *instances, const Mesh *mesh);
+void instance_buffer_update(InstanceBuffer *instances, mat4 *models, int count);
+void instance_buffer_destroy(InstanceBuffer *instances);
+
+void instance_draw(const Mesh *mesh, const InstanceBuffer *instances);
+void instance_benchmark(const Mesh *mesh, unsigned int shader_program, int count, int frames);
+
+#endif
@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "jobs.h"
+
+// Claim and run indices of the current batch until none are left.
+static void run_batch(JobSystem *jobs) {
+	int index;
+	while ((index = SDL_AtomicAdd(&jobs->next, 1)) < jobs->count) {
+		jobs->fn(jobs->ctx, index);
+	}
+}
+
+static int worker(void *data) {
+	JobSystem *jobs = data;
+	int seen = 0;
+
+	SDL_LockMutex(jobs->mutex);
+	while (1) {
+		while (jobs->generation == seen && !jobs->quit) {
+			SDL_CondWait(jobs->start, jobs->mutex);
+		}
+		if (jobs->quit) {
+			break;
+		}
+		seen = jobs->generation;
+		SDL_UnlockMutex(jobs->mutex);
+
+		run_batch(jobs);
+
+		SDL_LockMutex(jobs->mutex);
+		if (--jobs->busy == 0) {
+			SDL_CondSignal(jobs->finished);
+		}
+	}
+	SDL_UnlockMutex(jobs->mutex);
+	return 0;
+}
+
+// Start `thread_count` workers, or one per core besides the calling thread when 0.
+JobSystem *jobs_create(int thread_count) {
+	if (thread_count <= 0) {
+		thread_count = SDL_GetCPUCount() - 1;
+	}
+
+	JobSystem *jobs = calloc(1, sizeof(JobSystem));
+	jobs->mutex = SDL_CreateMutex();
+	jobs->start = SDL_CreateCond();
+	jobs->finished = SDL_CreateCond();
+	jobs->threads = calloc(thread_count, sizeof(SDL_Thread *));
+
+	for (int i = 0; i < thread_count; i++) {
+		jobs->threads[i] = SDL_CreateThread(worker, "worker", jobs);
+		if (!jobs->threads[i]) {
+			printf("Could not create worker thread, error: %s\n", SDL_GetError());
+			break;
+		}
+		jobs->thread_count++;
+	}
+
+	return jobs;
+}
+
+// Run a batch across all workers and the calling thread. Returns when every index is done.
+void jobs_run(JobSystem *jobs, JobFn fn, void *ctx, int count) {
+	if (jobs->thread_count == 0 || count <= 1) {
+		for (int i = 0; i < count; i++) {
+			fn(ctx, i);
+		}
+		return;
+	}
+
+	SDL_LockMutex(jobs->mutex);
+	jobs->fn = fn;
+	jobs->ctx = ctx;
+	jobs->count = count;
+	SDL_AtomicSet(&jobs->next, 0);
+	jobs->busy = jobs->thread_count;
+	jobs->generation++;
+	SDL_CondBroadcast(jobs->start);
+	SDL_UnlockMutex(jobs->mutex);
+
+	run_batch(jobs);
+
+	SDL_LockMutex(jobs->mutex);
+	while (jobs->busy > 0) {
+		SDL_CondWait(jobs->finished, jobs->mutex);
+	}
+	SDL_UnlockMutex(jobs->mutex);
+}
+
+// Threads working on a batch, including the caller.
+int jobs_thread_count(const JobSystem *jobs) {
+	return jobs->thread_count + 1;
+}
+
+void jobs_destroy(JobSystem *jobs) {
+	SDL_LockMutex(jobs->mutex);
+	jobs->quit = 1;
+	SDL_CondBroadcast(jobs->start);
+	SDL_UnlockMutex(jobs->mutex);
+
+	for (int i = 0; i < jobs->thread_count; i++) {
+		SDL_WaitThread(jobs->threads[i], NULL);
+	}
+
+	SDL_DestroyCond(jobs->finished);
+	SDL_DestroyCond(jobs->start);
+	SDL_DestroyMutex(jobs->mutex);
+	free(jobs->threads);
+	free(jobs);
+}
@@ -0,0 +1,33 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <SDL2/SDL.h>
+
+// Runs fn(ctx, index) for every index in [0, count).
+typedef void (*JobFn)(void *ctx, int index);
+
+// Fixed pool of SDL worker threads. The calling thread helps out, so the pool
+// has one thread fewer than the number of cores it uses.
+typedef struct {
+	SDL_Thread **threads;
+	int thread_count;
+	SDL_mutex *mutex;
+	SDL_cond *start;
+	SDL_cond *finished;
+	int generation; // Bumped for every batch so sleeping workers know to wake.
+	int busy;       // Workers still running the current batch.
+	int quit;
+
+	// Current batch.
+	JobFn fn;
+	void *ctx;
+	int count;
+	SDL_atomic_t next; // Next unclaimed index.
+} JobSystem;
+
+JobSystem *jobs_create(int thread_count);
+void jobs_run(JobSystem *jobs, JobFn fn, void *ctx, int count);
+int jobs_thread_count(const JobSystem *jobs);
+void jobs_destroy(JobSystem *jobs);
+
+#endif
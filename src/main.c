@@ -5,27 +5,49 @@
 #include <stdlib.h>
 #include <assert.h> 
 #include <string.h>
+#include "mesh.h"
+#include "instance.h"
+#include "ubo.h"
+#include "shader.h"
+#include "shader_manager.h"
+#include "shader_watch.h"
+#include "shader_library.h"
+#include "gl_state.h"
+#include "program_cache.h"
+#include "render_queue.h"
+#include "jobs.h"
+#include "command_list.h"
+#include "scene.h"
+#include "cull.h"
+#include "bvh.h"
+#include "occlusion.h"
+#include "soft_occlusion.h"
+#include "batch.h"
+#include "overdraw.h"
+#include "cluster.h"
+#include "gbuffer.h"
+#include "shadow.h"
+#include "profiler.h"
+#include "headless.h"
+#include "fullscreen.h"
+#include "soft_raster.h"
+#include "soft_scene.h"
 
 static const int WIDTH = 800;
 static const int HEIGHT = 800;
+static const float NEAR_Z = 0.01f; // Clip planes of glm_perspective_default().
+static const float FAR_Z = 100.0f;
 
-static const char *vertex_shader_source=
-	"#version 330 core\n"
-	"layout (location = 0) in vec3 pos;\n"
-	"uniform mat4 model;\n"
-	"uniform mat4 view;\n"
-	"uniform mat4 proj;\n"
-	"void main() {\n"
-	"	gl_Position = view * vec4(pos, 1.0f);\n"
-	"}\0";
-static const char *fragment_shader_source =
-	"#version 330 core\n"
-	"out vec4 FragColor;\n"
-	"void main() {\n"
-	"	FragColor = vec4(1.0f, 0.0f, 0.0f, 0.0f);\n" // Red.
-	"}\0";
-
-// Manually initializing 36 individual vertices instead of using 8 vertices and index array.
+// Shader sources, relative to where the game is started. Edits are picked up
+// while running.
+#define SHADER_DIRECTORY "shaders"
+
+// Permutation bits of the scene shader.
+enum { SCENE_FOG = 1 << 0 };
+#define SCENE_FEATURE_COUNT 1
+static const char *scene_features[SCENE_FEATURE_COUNT] = {"FOG"};
+
+// Unindexed cube, 36 vertices. mesh_load() deduplicates it into 8 vertices and an index array.
 static const float vertices[] = {
     -0.5f, -0.5f, -0.5f,
      0.5f, -0.5f, -0.5f,
@@ -70,58 +92,6 @@ static const float vertices[] = {
     -0.5f,  0.5f, -0.5f
 };
 
-unsigned int get_shader_program() {
-	// Error handling.
-	int success, log_length;
-	char *log;
-
-	// Vertex shader.
-	unsigned int vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertex_shader, 1, &vertex_shader_source, NULL);
-	glCompileShader(vertex_shader);
-	// Check for error compiling vertex shader.
-	glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &success);
-	glGetShaderiv(vertex_shader, GL_INFO_LOG_LENGTH, &log_length);
-	log = malloc(log_length);
-	if (!success) {
-		glGetShaderInfoLog(vertex_shader, log_length, NULL, log);
-		printf("Vertex shader could not be compiled!\n");
-		printf("Vertex shader ERROR: %s\n", log);
-	}
-
-	// Fragment shader.
-	unsigned int fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragment_shader, 1, &fragment_shader_source, NULL);
-	glCompileShader(fragment_shader);
-	// Check for error compiling fragment shader.
-	glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &success);
-	glGetShaderiv(fragment_shader, GL_INFO_LOG_LENGTH, &log_length);
-	log = realloc(log, log_length);
-	if (!success) {
-		glGetShaderInfoLog(fragment_shader, log_length, NULL, log);
-		printf("Fragment shader could not be compiled!\n");
-		printf("Fragment shader ERROR: %s\n", log);
-	}
-
-	// Link shaders.
-	unsigned int shader_program = glCreateProgram();
-	glAttachShader(shader_program, vertex_shader);
-	glAttachShader(shader_program, fragment_shader); glLinkProgram(shader_program);
-	glGetProgramiv(shader_program, GL_LINK_STATUS, &success); 
-	glGetProgramiv(shader_program, GL_INFO_LOG_LENGTH, &log_length);
-	log = realloc(log, log_length);
-	if (!success) {
-		glGetShaderInfoLog(shader_program, log_length, NULL, log); printf("Error linking shaders with shader_program\n");
-	
-	}
-
-	// Cleanup.
-	free(log);
-	glDeleteShader(vertex_shader);
-	glDeleteShader(fragment_shader);
-	return shader_program;
-}
-
 // Resize OpenGL viewport with new window size.
 void resize_opengl_viewport(SDL_Window *window) {
 	int h = SDL_GetWindowSurface(window)->h;
@@ -148,40 +118,70 @@ void print_keyboard_event(SDL_KeyboardEvent *key) {
 	printf("%s\n", SDL_GetKeyName(key->keysym.sym));
 }
 
-SDL_Window *window_init(int height, int width) {
-	// Init SDL.
+SDL_Window *window_init(int height, int width, int headless, Uint32 flags) {
+	// Init SDL. Without a display the offscreen driver still gives an OpenGL context.
+	if (headless) {
+		headless_init();
+	}
 	if (SDL_Init(SDL_INIT_VIDEO) < 0) {
 		printf("SDL could not init, error: %s\n", SDL_GetError());
 		exit(1);
 	}
 
+	// Set necessary attributes. (Hints) Some platforms pick the pixel format when
+	// the window is created, so these go first.
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_FORWARD_COMPATIBLE_FLAG, GL_TRUE);
+	SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+	SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
+
 	SDL_Window *window = SDL_CreateWindow(
 		"Game",
 		SDL_WINDOWPOS_CENTERED,
 		SDL_WINDOWPOS_CENTERED,
 		height,
 		width,
-		SDL_WINDOW_OPENGL // Window usable with OpenGL context.
+		flags | (headless ? SDL_WINDOW_HIDDEN : 0) // SDL_WINDOW_OPENGL unless drawing in software.
 	);
-	SDL_SetWindowResizable(window, SDL_TRUE);
-
-	// Set necessary attributes. (Hints)
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_FORWARD_COMPATIBLE_FLAG, GL_TRUE);
-
 
 	// Print and crash program if unable to open window.
 	if (!window) {
 		printf("Failed to init window, closing now");
 		exit(1);
 	}
+	if (!headless) {
+		SDL_SetWindowResizable(window, SDL_TRUE);
+	}
 
 	return window;
 }
 
-void camera(unsigned int shader_program) {
+// Frame dump file name: `path` with a "%d" in it replaced by the frame number.
+void dump_name(const char *path, int frame, char *dest, size_t size) {
+	const char *number = strstr(path, "%d");
+	if (!number) {
+		snprintf(dest, size, "%s", path);
+		return;
+	}
+	snprintf(dest, size, "%.*s%04d%s", (int)(number - path), path, frame, number + 2);
+}
+
+// World space ray through a window pixel.
+void mouse_ray(SDL_Window *window, FrameUniforms *frame, int x, int y, vec3 origin, vec3 dir) {
+	int w, h;
+	SDL_GetWindowSize(window, &w, &h);
+	vec4 viewport = {0.0f, 0.0f, (float)w, (float)h};
+	vec3 far_point;
+	glm_unproject((vec3){(float)x, (float)(h - y), 0.0f}, frame->view_proj, viewport, origin);
+	glm_unproject((vec3){(float)x, (float)(h - y), 1.0f}, frame->view_proj, viewport, far_point);
+	glm_vec3_sub(far_point, origin, dir);
+	glm_vec3_normalize(dir);
+}
+
+// `ticks` is the animation time in milliseconds.
+void camera(FrameUniforms *frame, Uint32 ticks) {
 	// Unit vectors.
 	vec3 up = GLM_YUP;
 	vec3 right = GLM_XUP;
@@ -189,30 +189,173 @@ void camera(unsigned int shader_program) {
 	vec3 cam_direction = {0.0f, 0.0f, 1.0f};
 
 	vec3 cam_pos = {0.0f, 0.0f, 3.0f}; // Position of camera in world space.
-	cam_direction[0] = sin(SDL_GetTicks()); // Spinning cube! (Sort of.)
-
-	mat4 model = GLM_MAT4_IDENTITY;
-	mat4 view = GLM_MAT4_IDENTITY;
-	mat4 proj = GLM_MAT4_IDENTITY;
-	glm_lookat(cam_direction, forward, up, view);
-	glm_perspective_default(glm_rad(45.0f), proj);
-
-	int model_loc = glGetUniformLocation(shader_program, "model");
-	int view_loc = glGetUniformLocation(shader_program, "view");
-	int proj_loc = glGetUniformLocation(shader_program, "proj");
-	glUniformMatrix4fv(model_loc, 1, GL_FALSE, model);
-	glUniformMatrix4fv(view_loc, 1, GL_FALSE, view);
-	glUniformMatrix4fv(proj_loc, 1, GL_FALSE, proj);
+	cam_direction[0] = sin(ticks); // Spinning cube! (Sort of.)
+
+	glm_lookat(cam_direction, forward, up, frame->view);
+	glm_perspective_default(glm_rad(45.0f), frame->proj);
+	glm_mat4_mul(frame->proj, frame->view, frame->view_proj);
+	glm_mat4_inv(frame->view_proj, frame->inv_view_proj);
+	glm_vec4(cam_direction, 1.0f, frame->cam_pos);
+}
+
+// Check a scene program against the renderer's vertex layout and bind its blocks
+// and samplers. Fullscreen passes have no attributes to check.
+int check_scene_program(void *ctx, ShaderProgram *program) {
+	if ((program->attrib_count > 0 &&
+		(!shader_check_attrib(program, "pos", 0, GL_FLOAT_VEC3) ||
+		!shader_check_attrib(program, "model", INSTANCE_ATTRIB_MODEL, GL_FLOAT_MAT4))) ||
+		!ubo_bind_program(program) ||
+		!clusters_bind_program(program) ||
+		!gbuffer_bind_program(program) ||
+		!shadow_bind_program(program)) {
+		printf("Shader program does not match the renderer\n");
+		return 0;
+	}
+	return 1;
+}
+
+// Draw the scene with the CPU rasterizer instead of OpenGL, for machines without
+// a GPU. Same options as the OpenGL path where they apply. (--software)
+int software_main(int object_count, int headless_frames, const char *dump_path) {
+	int headless = headless_frames > 0;
+	SDL_Window *window = window_init(WIDTH, HEIGHT, headless, 0);
+	JobSystem *jobs = jobs_create(0);
+	MeshData cube_data = mesh_data_load("cube", vertices, sizeof(vertices) / (3 * sizeof(float)), 3);
+	Mesh cube = mesh_describe(&cube_data); // Bounds and LODs for culling, nothing on a GPU.
+	Scene scene = scene_create(object_count, &cube, 0);
+	int *visible = malloc(object_count * sizeof(int));
+	int w, h;
+	SDL_GetWindowSize(window, &w, &h);
+	SoftRaster raster = soft_raster_create(w, h, jobs);
+
+	// Same sun as shadow_create().
+	SoftSceneUniforms uniforms = {GLM_MAT4_IDENTITY_INIT, GLM_MAT4_IDENTITY_INIT, {1.0f, 0.0f, 0.0f, 0.5f}, {0.0f, 0.0f, 0.0f, 1.0f}, {0.4f, 1.0f, 0.3f, 0.0f}, {0.6f, 0.6f, 0.55f, 0.0f}};
+	glm_vec3_normalize(uniforms.sun_dir);
+	FrameUniforms frame;
+
+	int running = 1;
+	int frame_number = 0;
+	Uint64 start = SDL_GetPerformanceCounter();
+	SDL_Event event;
+	while (running) {
+		SDL_GetWindowSize(window, &w, &h);
+		if (w != raster.width || h != raster.height) {
+			soft_raster_destroy(&raster);
+			raster = soft_raster_create(w, h, jobs);
+		}
+		camera(&frame, headless ? (Uint32)frame_number * HEADLESS_FRAME_MS : SDL_GetTicks()); // Like the OpenGL path.
+		glm_vec4_copy(frame.cam_pos, uniforms.cam_pos);
+		int visible_count = scene_cull(&scene, frame.view_proj, visible);
+		soft_raster_begin(&raster, (vec4){0.0f, 0.0f, 0.0f, 1.0f});
+		for (int v = 0; v < visible_count; v++) {
+			glm_mat4_copy(scene.models[visible[v]], uniforms.model);
+			glm_mat4_mul(frame.view_proj, uniforms.model, uniforms.mvp);
+			soft_raster_draw(&raster, &cube_data, 0, &soft_scene_program, &uniforms, sizeof(uniforms));
+		}
+		soft_raster_end(&raster);
+
+		frame_number++;
+		if (headless) {
+			if (dump_path && (frame_number == headless_frames || strstr(dump_path, "%d"))) {
+				char name[512];
+				dump_name(dump_path, frame_number, name, sizeof(name));
+				soft_raster_write_ppm(&raster, name);
+			}
+			running = frame_number < headless_frames;
+		} else {
+			char title[64];
+			snprintf(title, sizeof(title), "Game (software) - %d triangles", raster.triangle_count);
+			SDL_SetWindowTitle(window, title);
+			soft_raster_present(&raster, window);
+		}
+
+		if (SDL_PollEvent(&event)) {
+			if (event.type == SDL_QUIT) {
+				running = 0;
+			} else if (event.type == SDL_KEYDOWN) {
+				close_on_esc(&event.key, &running);
+			}
+		}
+	}
+	double ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+	printf("Rendered %d frames in software in %.1f ms, %.3f ms per frame\n", frame_number, ms, ms / frame_number);
+
+	soft_raster_destroy(&raster);
+	free(visible);
+	scene_destroy(&scene);
+	mesh_data_free(&cube_data);
+	jobs_destroy(jobs);
+	SDL_DestroyWindow(window);
+	SDL_Quit();
+	return 0;
 }
 
-int main() {
+int main(int argc, char *argv[]) {
+	// Command line options.
+	int object_count = 1;
+	int batched = 0; // Draw the scene from one static batch instead of per object.
+	int prepass = 0; // Depth-only pass first, then shade with GL_EQUAL. (P toggles)
+	int show_overdraw = 0; // Heat map of shaded fragments per pixel. (O toggles)
+	int light_count = 256; // Dynamic point lights.
+	int deferred = 0; // G-buffer and a fullscreen lighting pass instead of forward shading. (G toggles)
+	const char *profile_path = NULL; // CSV file of every pass's CPU and GPU time per frame.
+	int headless_frames = 0; // Render this many frames offscreen, without a display, then exit.
+	const char *dump_path = NULL; // PPM of the last headless frame, or of every frame if it has a "%d".
+	int software = 0; // CPU rasterizer, no OpenGL at all.
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--objects") == 0 && i + 1 < argc) {
+			object_count = atoi(argv[i + 1]);
+		} else if (strcmp(argv[i], "--batch") == 0) {
+			batched = 1;
+		} else if (strcmp(argv[i], "--prepass") == 0) {
+			prepass = 1;
+		} else if (strcmp(argv[i], "--overdraw") == 0) {
+			show_overdraw = 1;
+		} else if (strcmp(argv[i], "--deferred") == 0) {
+			deferred = 1;
+		} else if (strcmp(argv[i], "--lights") == 0 && i + 1 < argc) {
+			light_count = atoi(argv[i + 1]);
+		} else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+			profile_path = argv[i + 1];
+		} else if (strcmp(argv[i], "--headless") == 0 && i + 1 < argc) {
+			headless_frames = atoi(argv[i + 1]);
+		} else if (strcmp(argv[i], "--dump") == 0 && i + 1 < argc) {
+			dump_path = argv[i + 1];
+		} else if (strcmp(argv[i], "--software") == 0) {
+			software = 1;
+		}
+	}
+
+	// Benchmark frustum culling and exit, no window needed. (--bench-cull [count])
+	if (argc > 1 && strcmp(argv[1], "--bench-cull") == 0) {
+		cull_benchmark(argc > 2 ? atoi(argv[2]) : 1000000);
+		return 0;
+	}
+
+	// Benchmark software occlusion culling and exit, no GPU needed. (--bench-soft-occlusion [count])
+	if (argc > 1 && strcmp(argv[1], "--bench-soft-occlusion") == 0) {
+		soft_occlusion_benchmark(argc > 2 ? atoi(argv[2]) : 100000);
+		return 0;
+	}
+
+	if (software) {
+		return software_main(object_count, headless_frames, dump_path);
+	}
+
 	// Window creation.
-	SDL_Window *window = window_init(WIDTH, HEIGHT);
+	int headless = headless_frames > 0;
+	SDL_Window *window = window_init(WIDTH, HEIGHT, headless, SDL_WINDOW_OPENGL);
 	if (!window) {
 		printf("Could not create window!");
 		exit(1);
 	}
-	SDL_GL_CreateContext(window);
+	if (!SDL_GL_CreateContext(window)) {
+		printf("Could not create OpenGL context, error: %s\n", SDL_GetError());
+		exit(1);
+	}
+	if (dump_path && !headless) {
+		printf("--dump needs --headless, not dumping\n");
+	}
 
 	// Load GLAD. (OpenGL functions)
 	int version = gladLoadGLLoader(SDL_GL_GetProcAddress);
@@ -222,40 +365,354 @@ int main() {
 	} else {
 		printf("Initialized OpenGL! Version: %d\n", version);
 	}
+	gl_state_init(); // Filter redundant state changes from here on.
+
+	// Headless frames go to an FBO; there may be no default framebuffer at all.
+	// Passes that end on the screen draw into `screen`.
+	HeadlessTarget headless_target = {0};
+	unsigned int screen = 0;
+	if (headless) {
+		headless_target = headless_create(WIDTH, HEIGHT);
+		screen = headless_target.fbo;
+	}
 
-	// Shader program.
-	unsigned int shader_program = get_shader_program();
+	// Program binaries from earlier runs.
+	char *pref_path = SDL_GetPrefPath("aionitel", "sdl_game");
+	program_cache_init(pref_path);
+	SDL_free(pref_path);
+
+	// Depth buffer.
+	int depth_bits = 0;
+	SDL_GL_GetAttribute(SDL_GL_DEPTH_SIZE, &depth_bits);
+	printf("Depth buffer: %d bits\n", depth_bits);
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LESS);
+	glClearDepth(1.0);
+
+	// Shader programs. They compile in the background while loading goes on, and
+	// the scene draws flat grey until they are ready.
+	char *vertex_shader_source = shader_source_load(SHADER_DIRECTORY "/scene.vert", NULL);
+	char *placeholder_fragment_source = shader_source_load(SHADER_DIRECTORY "/placeholder.frag", NULL);
+	if (!vertex_shader_source || !placeholder_fragment_source) {
+		printf("Shader sources missing, closing now\n");
+		exit(1);
+	}
+	ShaderManager shaders = shader_manager_create(vertex_shader_source, placeholder_fragment_source, check_scene_program, NULL);
+	free(placeholder_fragment_source);
+	if (!shaders.placeholder.linked) {
+		printf("Placeholder program does not match the renderer, closing now\n");
+		exit(1);
+	}
 
-	// Vertex buffer and array setup.
-	unsigned int vbo, vao;
-	glGenVertexArrays(1, &vao);
-	glGenBuffers(1, &vbo);
+	// Scene shader permutations, compiled the first time they are drawn with.
+	ShaderLibrary library = shader_library_create(&shaders);
+	int scene_shader = shader_library_add(&library, SHADER_DIRECTORY "/scene.vert", SHADER_DIRECTORY "/scene.frag", scene_features, SCENE_FEATURE_COUNT);
+	int gbuffer_shader = shader_library_add(&library, SHADER_DIRECTORY "/scene.vert", SHADER_DIRECTORY "/gbuffer.frag", scene_features, SCENE_FEATURE_COUNT);
+	int resolve_shader = shader_library_add(&library, SHADER_DIRECTORY "/fullscreen.vert", SHADER_DIRECTORY "/deferred.frag", scene_features, SCENE_FEATURE_COUNT);
+	uint32_t scene_permutation = 0;
+	if (shader_library_variant(&library, scene_shader, scene_permutation) < 0) {
+		printf("Shader sources missing, closing now\n");
+		exit(1);
+	}
+	int shadow_shader = shader_manager_add_files(&shaders, SHADER_DIRECTORY "/shadow.vert", SHADER_DIRECTORY "/shadow.frag", NULL);
+	ShaderWatch *shader_watch = shader_watch_create(SHADER_DIRECTORY);
+
+	// Uniform blocks: camera once per frame, constants per draw. Every object can
+	// be drawn once by the scene and once into each shadow cascade.
+	UboSystem ubo = ubo_create((object_count > 1024 ? object_count : 1024) * (1 + SHADOW_CASCADES));
+	FrameUniforms frame;
+
+	// Indexed, vertex cache optimized cube. The CPU copy is kept for static batching.
+	MeshData cube_data = mesh_data_load("cube", vertices, sizeof(vertices) / (3 * sizeof(float)), 3);
+	Mesh cube = mesh_upload(&cube_data);
+
+	// Benchmark instanced against per object drawing and exit. (--bench-instancing [count])
+	if (argc > 1 && strcmp(argv[1], "--bench-instancing") == 0) {
+		int count = argc > 2 ? atoi(argv[2]) : 100000;
+		DrawUniforms draw = {GLM_MAT4_IDENTITY_INIT, {1.0f, 0.0f, 0.0f, 0.5f}}; // Red, half specular.
+		shader_manager_wait(&shaders, shader_library_variant(&library, scene_shader, scene_permutation));
+		unsigned int program = shader_library_program(&library, scene_shader, scene_permutation)->id;
+		glUseProgram(program);
+		camera(&frame, SDL_GetTicks());
+		ubo_begin_frame(&ubo, &frame);
+		ubo_bind_draw(&ubo, ubo_push_draws(&ubo, &draw, 1), 0);
+		instance_benchmark(&cube, program, count, 60);
+		ubo_destroy(&ubo);
+		mesh_destroy(&cube);
+		mesh_data_free(&cube_data);
+		shader_watch_destroy(shader_watch);
+		shader_library_destroy(&library);
+		shader_manager_destroy(&shaders);
+		free(vertex_shader_source);
+		SDL_DestroyWindow(window);
+		SDL_Quit();
+		return 0;
+	}
 
-	glBindVertexArray(vao);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+	// Scene objects draw one identity instance each and take their model matrix
+	// from the Draw block.
+	mat4 identity = GLM_MAT4_IDENTITY_INIT;
+	InstanceBuffer instances = instance_buffer_create(1);
+	instance_buffer_attach(&instances, &cube);
+	instance_buffer_update(&instances, &identity, 1);
+	Scene scene = scene_create(object_count, &cube, shader_library_program(&library, scene_shader, scene_permutation)->id);
+	MeshBvh cube_bvh = mesh_bvh_build(vertices, NULL, sizeof(vertices) / (3 * sizeof(float)), 3); // For mouse picking.
+
+	// With --batch the scene is pre-transformed into shared buffers and drawn with
+	// one multi-draw per page, using an identity Draw block.
+	StaticBatch batch = static_batch_create(cube_data.stride);
+	DrawUniforms batch_draw = {GLM_MAT4_IDENTITY_INIT, {1.0f, 0.0f, 0.0f, 0.5f}}; // Red, half specular.
+	if (batched) {
+		for (int i = 0; i < scene.count; i++) {
+			static_batch_add(&batch, &cube_data, scene.models[i]);
+		}
+		static_batch_build(&batch);
+		for (int p = 0; p < batch.page_count; p++) {
+			instance_buffer_attach(&instances, &batch.pages[p]);
+		}
+	}
+
+	// Objects hidden behind others are skipped using last frame's occlusion queries.
+	OcclusionSystem occlusion = occlusion_create(object_count, &cube);
+	if (!occlusion.program.linked || occlusion.mvp.location < 0) {
+		printf("Occlusion proxy program failed, closing now\n");
+		exit(1);
+	}
+
+	// Shared by the overdraw heat map and the deferred resolve.
+	FullscreenPass fullscreen = fullscreen_create(SHADER_DIRECTORY "/fullscreen.vert");
+	if (!fullscreen.vertex_source) {
+		printf("Shader sources missing, closing now\n");
+		exit(1);
+	}
 
-	// Position attribute.
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	glUseProgram(shader_program);
+	// Overdraw measurement reuses the scene's vertex shader and blocks.
+	OverdrawView overdraw = overdraw_create(vertex_shader_source, &fullscreen);
+	if (!overdraw.count_program.linked || !ubo_bind_program(&overdraw.count_program)) {
+		printf("Overdraw program does not match the renderer, closing now\n");
+		exit(1);
+	}
+
+	// Draws are recorded on worker threads, one command list per bucket.
+	JobSystem *jobs = jobs_create(0);
+	int *visible = malloc(object_count * sizeof(int));
+	int *drawn = malloc(object_count * sizeof(int));
+	SceneView view = {
+		.scene = &scene,
+		.visible = drawn,
+		.conditions = occlusion.conditions,
+		.near_z = NEAR_Z,
+		.far_z = FAR_Z,
+		.bucket_count = jobs_thread_count(jobs),
+	};
+	CommandList *lists = calloc(view.bucket_count, sizeof(CommandList));
+	view.bucket_triangles = calloc(view.bucket_count, sizeof(int));
+
+	// The nearest objects are rasterized on the CPU to hide the ones behind them
+	// before any GPU work.
+	SoftOcclusion soft_occlusion = soft_occlusion_create(256, 256, jobs);
+	int occluders[SCENE_MAX_OCCLUDERS];
+	RenderQueue queue = render_queue_create(1024);
+
+	// Point lights scattered through the scene, bobbing up and down. Binned into
+	// view space clusters every frame for the forward pass.
+	LightClusters clusters = clusters_create(light_count, NEAR_Z, FAR_Z);
+	GBuffer gbuffer = gbuffer_create(&fullscreen);
+	ShadowCascades shadows = shadow_create(NEAR_Z, FAR_Z);
+	Profiler profiler = profiler_create(profile_path);
+	light_count = clusters.capacity;
+	PointLight *lights = calloc(light_count > 0 ? light_count : 1, sizeof(PointLight));
+	float *light_heights = malloc((light_count > 0 ? light_count : 1) * sizeof(float));
+	srand(2);
+	for (int i = 0; i < light_count; i++) {
+		for (int k = 0; k < 3; k++) {
+			lights[i].position[k] = rand() % 1200 / 1000.0f - 0.6f;
+			lights[i].color[k] = rand() % 1000 / 1000.0f;
+		}
+		lights[i].radius = 0.1f + rand() % 100 / 500.0f;
+		light_heights[i] = lights[i].position[1];
+	}
 	glViewport(0, 0, WIDTH, HEIGHT);
 
+	// Headless frames are for comparing images, so they must not depend on how
+	// far the compiler got: finish every program the first frame can draw with.
+	if (headless) {
+		shader_manager_wait(&shaders, shader_library_variant(&library, scene_shader, scene_permutation));
+		shader_manager_wait(&shaders, shader_library_variant(&library, gbuffer_shader, scene_permutation));
+		shader_manager_wait(&shaders, shader_library_variant(&library, resolve_shader, scene_permutation));
+		shader_manager_wait(&shaders, shadow_shader);
+	}
+
 	// Main game loop.
 	int running = 1;
+	int frame_number = 0;
+	Uint64 start = SDL_GetPerformanceCounter();
 	SDL_Event event;
 	while (running) {
-		glClear(GL_COLOR_BUFFER_BIT);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
-		camera(shader_program);
-		SDL_GL_SwapWindow(window); // Swap window (buffer) to update current frame.
+		// Rebuild edited shaders, then pick up whatever finished linking.
+		char changed[SHADER_WATCH_NAME_LENGTH];
+		while (shader_watch_next(shader_watch, changed)) {
+			shader_manager_reload(&shaders, changed);
+		}
+		shader_manager_poll(&shaders);
+		profiler_begin_frame(&profiler);
+		// Deferred frames draw into the G-buffer, forward until its programs are ready.
+		int deferred_frame = deferred && !show_overdraw &&
+			shader_manager_ready(&shaders, shader_library_variant(&library, gbuffer_shader, scene_permutation)) &&
+			shader_manager_ready(&shaders, shader_library_variant(&library, resolve_shader, scene_permutation));
+		scene.program = shader_library_program(&library, deferred_frame ? gbuffer_shader : scene_shader, scene_permutation)->id;
+		// Animation time. Headless runs step it per frame, so dumps don't depend on the clock.
+		Uint32 ticks = headless ? (Uint32)frame_number * HEADLESS_FRAME_MS : SDL_GetTicks();
+		camera(&frame, ticks);
+		ubo_begin_frame(&ubo, &frame);
+
+		// Cull, record the scene on all cores, then merge, sort and submit on this thread.
+		profiler_begin(&profiler, "cull");
+		int visible_count = scene_cull(&scene, frame.view_proj, visible);
+		soft_occlusion_begin(&soft_occlusion, frame.view_proj);
+		int occluder_count = scene_occluders(&scene, visible, visible_count, frame.cam_pos, occluders);
+		for (int i = 0; i < occluder_count; i++) {
+			soft_occlusion_add_occluder(&soft_occlusion, vertices, NULL, sizeof(vertices) / (3 * sizeof(float)), 3, scene.models[occluders[i]]);
+		}
+		soft_occlusion_rasterize(&soft_occlusion);
+		visible_count = soft_occlusion_test(&soft_occlusion, scene.boxes, visible, visible_count, visible);
+		view.visible_count = occlusion_filter(&occlusion, visible, visible_count, drawn);
+		glm_vec3_copy(frame.cam_pos, view.cam_pos);
+		glm_mat4_copy(frame.view_proj, view.view_proj);
+		glm_vec3_copy((vec3){frame.view[0][1], frame.view[1][1], frame.view[2][1]}, view.cam_up);
+		int w, h;
+		SDL_GetWindowSize(window, &w, &h);
+		glm_vec4_copy((vec4){0.0f, 0.0f, (float)w, (float)h}, view.viewport);
+
+		// Move and bin the lights.
+		float seconds = ticks / 1000.0f;
+		for (int i = 0; i < light_count; i++) {
+			lights[i].position[1] = light_heights[i] + 0.1f * sinf(seconds + i);
+		}
+		profiler_end(&profiler);
+		profiler_begin(&profiler, "lights");
+		clusters_bin(&clusters, jobs, lights, light_count, frame.view, frame.proj);
+		clusters_upload(&clusters, lights, w, h);
+		profiler_end(&profiler);
+
+		// Sun shadows, redrawing only the cascades that changed.
+		const ShaderProgram *shadow_program = shader_manager_ready(&shaders, shadow_shader) ? shader_manager_program(&shaders, shadow_shader) : NULL;
+		profiler_begin(&profiler, "shadows");
+		shadow_update(&shadows, &scene, &frame, shadow_program, &ubo, screen, w, h);
+		profiler_end(&profiler);
+
+		// Triangles drawn this frame, after culling and LOD selection.
+		int triangles = 0;
+		profiler_begin(&profiler, "scene");
+		if (show_overdraw) {
+			overdraw_begin(&overdraw, w, h);
+		} else if (deferred_frame) {
+			gbuffer_begin(&gbuffer, w, h);
+		} else {
+			glBindFramebuffer(GL_FRAMEBUFFER, screen);
+		}
+		queue.overdraw_program = show_overdraw ? overdraw.count_program.id : 0;
+		if (batched) {
+			for (int v = 0; v < view.visible_count; v++) {
+				scene.lods[drawn[v]] = (unsigned char)scene_select_lod(&scene, &view, drawn[v]);
+			}
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			size_t base = ubo_push_draws(&ubo, &batch_draw, 1);
+			if (base != (size_t)-1) { // Skipped this frame when the ring is full, already reported.
+				glUseProgram(show_overdraw ? overdraw.count_program.id : scene.program);
+				ubo_bind_draw(&ubo, base, 0);
+				if (prepass) {
+					glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+					static_batch_draw(&batch, drawn, view.visible_count, scene.lods);
+					glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+					glDepthFunc(GL_EQUAL);
+					glDepthMask(GL_FALSE);
+				}
+				if (show_overdraw) {
+					glEnable(GL_BLEND);
+					glBlendFunc(GL_ONE, GL_ONE);
+				}
+				triangles = static_batch_draw(&batch, drawn, view.visible_count, scene.lods);
+				glDisable(GL_BLEND);
+				glDepthFunc(GL_LESS);
+				glDepthMask(GL_TRUE);
+			}
+		} else {
+			command_lists_record(jobs, lists, view.bucket_count, scene_record_bucket, &view);
+			for (int i = 0; i < view.bucket_count; i++) {
+				triangles += view.bucket_triangles[i];
+			}
+			render_queue_clear(&queue);
+			command_lists_replay(lists, view.bucket_count, &ubo, &queue);
+			render_queue_sort(&queue);
+
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			if (prepass) {
+				render_queue_submit(&queue, &ubo, RENDER_PASS_DEPTH);
+			}
+			render_queue_submit(&queue, &ubo, prepass ? RENDER_PASS_EQUAL : RENDER_PASS_FORWARD);
+		}
+		profiler_end(&profiler);
+		char title[64];
+		snprintf(title, sizeof(title), "Game - %d triangles", triangles);
+		SDL_SetWindowTitle(window, title);
+		profiler_begin(&profiler, "occlusion");
+		occlusion_query(&occlusion, scene.boxes, visible, visible_count, frame.view_proj, frame.cam_pos);
+		profiler_end(&profiler);
+		if (deferred_frame) {
+			// After the queries, which test against the G-buffer's depth.
+			profiler_begin(&profiler, "resolve");
+			gbuffer_resolve(&gbuffer, shader_library_program(&library, resolve_shader, scene_permutation)->id, screen);
+			profiler_end(&profiler);
+		}
+		if (show_overdraw) {
+			overdraw_end(&overdraw, screen);
+		}
+		ubo_end_frame(&ubo);
+		profiler_end_frame(&profiler);
+		frame_number++;
+		if (headless) {
+			if (dump_path && (frame_number == headless_frames || strstr(dump_path, "%d"))) {
+				char name[512];
+				dump_name(dump_path, frame_number, name, sizeof(name));
+				headless_write_ppm(&headless_target, name);
+			}
+			glFlush(); // Nothing to present.
+			running = frame_number < headless_frames;
+		} else {
+			SDL_GL_SwapWindow(window); // Swap window (buffer) to update current frame.
+		}
+		gl_state_end_frame();
 
 		if (SDL_PollEvent(&event)) {
 			switch (event.type) {
+				case SDL_MOUSEBUTTONDOWN: {
+					vec3 origin, dir;
+					float distance;
+					mouse_ray(window, &frame, event.button.x, event.button.y, origin, dir);
+					int object = scene_pick(&scene, &cube_bvh, origin, dir, &distance);
+					if (object >= 0) {
+						printf("Picked object %d at distance %.3f\n", object, distance);
+					}
+					break;
+				}
 				case SDL_QUIT:
 					running = 0;
 					break;
 				case SDL_KEYDOWN:
+					if (event.key.keysym.scancode == SDL_SCANCODE_P) {
+						prepass = !prepass;
+						printf("Depth pre-pass %s\n", prepass ? "on" : "off");
+					} else if (event.key.keysym.scancode == SDL_SCANCODE_O) {
+						show_overdraw = !show_overdraw;
+						printf("Overdraw view %s\n", show_overdraw ? "on" : "off");
+					} else if (event.key.keysym.scancode == SDL_SCANCODE_G) {
+						deferred = !deferred;
+						printf("%s shading\n", deferred ? "Deferred" : "Forward");
+					} else if (event.key.keysym.scancode == SDL_SCANCODE_F) {
+						scene_permutation ^= SCENE_FOG;
+						printf("Fog %s\n", scene_permutation & SCENE_FOG ? "on" : "off");
+					}
 					close_on_esc(&event.key, &running);
 				case SDL_WINDOWEVENT_RESIZED:
 					resize_opengl_viewport(window);
@@ -263,10 +720,52 @@ int main() {
 		}
 	}
 
+	if (headless) {
+		glFinish();
+		double ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+		printf("Rendered %d frames in %.1f ms, %.3f ms per frame\n", frame_number, ms, ms / frame_number);
+	}
+	gl_state_report();
+	occlusion_report(&occlusion);
+	program_cache_report();
+	shadow_report(&shadows);
+	profiler_report(&profiler);
+
 	// Cleanup.
-	glDeleteVertexArrays(1, &vao);
-	glDeleteBuffers(1, &vbo);
-	glDeleteProgram(shader_program);
+	profiler_destroy(&profiler);
+	if (headless) {
+		headless_destroy(&headless_target);
+	}
+	shadow_destroy(&shadows);
+	gbuffer_destroy(&gbuffer);
+	clusters_destroy(&clusters);
+	free(lights);
+	free(light_heights);
+	render_queue_destroy(&queue);
+	for (int i = 0; i < view.bucket_count; i++) {
+		command_list_destroy(&lists[i]);
+	}
+	free(lists);
+	free(view.bucket_triangles);
+	soft_occlusion_destroy(&soft_occlusion);
+	free(visible);
+	free(drawn);
+	jobs_destroy(jobs);
+	occlusion_destroy(&occlusion);
+	mesh_bvh_destroy(&cube_bvh);
+	scene_destroy(&scene);
+	instance_buffer_destroy(&instances);
+	overdraw_destroy(&overdraw);
+	fullscreen_destroy(&fullscreen);
+	static_batch_destroy(&batch);
+	mesh_destroy(&cube);
+	mesh_data_free(&cube_data);
+	ubo_destroy(&ubo);
+	shader_watch_destroy(shader_watch);
+	shader_library_destroy(&library);
+	shader_manager_destroy(&shaders);
+	free(vertex_shader_source);
+	program_cache_shutdown();
 	SDL_DestroyWindow(window);
 	SDL_Quit();
 
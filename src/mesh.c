@@ -0,0 +1,423 @@
+#include <glad/glad.h>
+#include <cglm/cglm.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "mesh.h"
+
+// Cache size the triangle ordering is scored against. Larger than the simulated
+// FIFO so the ordering stays good on hardware with bigger caches.
+#define FORSYTH_CACHE_SIZE 32
+
+// FNV-1a over the raw bytes of one vertex.
+static unsigned int hash_vertex(const float *vertex, int stride) {
+	const unsigned char *bytes = (const unsigned char *)vertex;
+	unsigned int hash = 2166136261u;
+	for (size_t i = 0; i < stride * sizeof(float); i++) {
+		hash ^= bytes[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+// Deduplicate an unindexed triangle list into unique vertices plus an index list.
+MeshData mesh_data_from_vertices(const float *vertices, int vertex_count, int stride) {
+	MeshData data = {0};
+	size_t vertex_size = stride * sizeof(float);
+	data.stride = stride;
+	data.index_count = vertex_count;
+	data.vertices = malloc(vertex_count * vertex_size);
+	data.indices = malloc(vertex_count * sizeof(unsigned int));
+
+	// Open addressing table of indices into data.vertices, kept at most half full.
+	int table_size = 1;
+	while (table_size < vertex_count * 2) {
+		table_size <<= 1;
+	}
+	int *table = malloc(table_size * sizeof(int));
+	memset(table, -1, table_size * sizeof(int));
+
+	for (int i = 0; i < vertex_count; i++) {
+		const float *vertex = vertices + i * stride;
+		unsigned int slot = hash_vertex(vertex, stride) & (table_size - 1);
+		while (table[slot] != -1 && memcmp(data.vertices + table[slot] * stride, vertex, vertex_size) != 0) {
+			slot = (slot + 1) & (table_size - 1);
+		}
+		if (table[slot] == -1) {
+			table[slot] = data.vertex_count;
+			memcpy(data.vertices + data.vertex_count * stride, vertex, vertex_size);
+			data.vertex_count++;
+		}
+		data.indices[i] = table[slot];
+	}
+
+	free(table);
+	data.vertices = realloc(data.vertices, data.vertex_count * vertex_size);
+	data.lods[0].index_count = data.index_count;
+	data.lod_count = 1;
+	return data;
+}
+
+void mesh_data_free(MeshData *data) {
+	free(data->vertices);
+	free(data->indices);
+	memset(data, 0, sizeof(*data));
+}
+
+// Score of a vertex given its position in the simulated LRU cache and how many
+// triangles still use it. (Tom Forsyth, "Linear-Speed Vertex Cache Optimisation")
+static float forsyth_vertex_score(int cache_pos, int active_tris) {
+	if (active_tris == 0) {
+		return -1.0f; // No triangles left to draw with this vertex.
+	}
+
+	float score = 0.0f;
+	if (cache_pos >= 0) {
+		if (cache_pos < 3) {
+			// Used by the last triangle. Fixed score so strips don't get too long.
+			score = 0.75f;
+		} else {
+			score = powf(1.0f - (cache_pos - 3) * (1.0f / (FORSYTH_CACHE_SIZE - 3)), 1.5f);
+		}
+	}
+
+	// Boost vertices with few triangles left so they get finished off.
+	score += 2.0f * powf((float)active_tris, -0.5f);
+	return score;
+}
+
+// Reorder triangles in place for post-transform vertex cache hits.
+void mesh_optimize_vertex_cache(unsigned int *indices, int index_count, int vertex_count) {
+	int tri_count = index_count / 3;
+	if (tri_count == 0) {
+		return;
+	}
+
+	// Vertex to triangle adjacency. The first active[v] entries of each list are
+	// triangles that have not been emitted yet.
+	int *active = calloc(vertex_count, sizeof(int));
+	int *offsets = calloc(vertex_count + 1, sizeof(int));
+	int *adjacency = malloc(tri_count * 3 * sizeof(int));
+	for (int i = 0; i < tri_count * 3; i++) {
+		active[indices[i]]++;
+	}
+	for (int v = 0; v < vertex_count; v++) {
+		offsets[v + 1] = offsets[v] + active[v];
+	}
+	int *fill = malloc(vertex_count * sizeof(int));
+	memcpy(fill, offsets, vertex_count * sizeof(int));
+	for (int i = 0; i < tri_count * 3; i++) {
+		adjacency[fill[indices[i]]++] = i / 3;
+	}
+	free(fill);
+
+	int *cache_pos = malloc(vertex_count * sizeof(int));
+	float *vertex_score = malloc(vertex_count * sizeof(float));
+	for (int v = 0; v < vertex_count; v++) {
+		cache_pos[v] = -1;
+		vertex_score[v] = forsyth_vertex_score(-1, active[v]);
+	}
+
+	float *tri_score = malloc(tri_count * sizeof(float));
+	unsigned char *emitted = calloc(tri_count, 1);
+	int best = 0;
+	for (int t = 0; t < tri_count; t++) {
+		const unsigned int *tri = indices + t * 3;
+		tri_score[t] = vertex_score[tri[0]] + vertex_score[tri[1]] + vertex_score[tri[2]];
+		if (tri_score[t] > tri_score[best]) {
+			best = t;
+		}
+	}
+
+	unsigned int *out = malloc(tri_count * 3 * sizeof(unsigned int));
+	int cache[FORSYTH_CACHE_SIZE + 3];
+	int cache_count = 0;
+	int scan_cursor = 0;
+
+	for (int n = 0; n < tri_count; n++) {
+		if (best < 0) {
+			// Nothing in the cache has triangles left, restart from the next unused one.
+			while (emitted[scan_cursor]) {
+				scan_cursor++;
+			}
+			best = scan_cursor;
+		}
+
+		const unsigned int *tri = indices + best * 3;
+		memcpy(out + n * 3, tri, 3 * sizeof(unsigned int));
+		emitted[best] = 1;
+
+		// Remove the triangle from the active lists of its vertices.
+		for (int k = 0; k < 3; k++) {
+			int v = tri[k];
+			int *list = adjacency + offsets[v];
+			for (int i = 0; i < active[v]; i++) {
+				if (list[i] == best) {
+					list[i] = list[active[v] - 1];
+					list[active[v] - 1] = best;
+					active[v]--;
+					break;
+				}
+			}
+		}
+
+		// Move the triangle's vertices to the front of the LRU cache.
+		int new_cache[FORSYTH_CACHE_SIZE + 3];
+		int new_count = 0;
+		for (int k = 0; k < 3; k++) {
+			if ((k == 1 && tri[1] == tri[0]) || (k == 2 && (tri[2] == tri[0] || tri[2] == tri[1]))) {
+				continue; // Degenerate triangle.
+			}
+			new_cache[new_count++] = tri[k];
+		}
+		for (int i = 0; i < cache_count; i++) {
+			int v = cache[i];
+			if (v != (int)tri[0] && v != (int)tri[1] && v != (int)tri[2]) {
+				new_cache[new_count++] = v;
+			}
+		}
+
+		// Rescore everything that was touched, including vertices pushed out.
+		for (int i = 0; i < new_count; i++) {
+			int v = new_cache[i];
+			cache_pos[v] = i < FORSYTH_CACHE_SIZE ? i : -1;
+			vertex_score[v] = forsyth_vertex_score(cache_pos[v], active[v]);
+		}
+
+		// Next triangle is the best one using a cached vertex.
+		best = -1;
+		float best_score = -1.0f;
+		for (int i = 0; i < new_count; i++) {
+			int v = new_cache[i];
+			int *list = adjacency + offsets[v];
+			for (int j = 0; j < active[v]; j++) {
+				int t = list[j];
+				const unsigned int *other = indices + t * 3;
+				tri_score[t] = vertex_score[other[0]] + vertex_score[other[1]] + vertex_score[other[2]];
+				if (tri_score[t] > best_score) {
+					best_score = tri_score[t];
+					best = t;
+				}
+			}
+		}
+
+		cache_count = new_count < FORSYTH_CACHE_SIZE ? new_count : FORSYTH_CACHE_SIZE;
+		memcpy(cache, new_cache, cache_count * sizeof(int));
+	}
+
+	memcpy(indices, out, tri_count * 3 * sizeof(unsigned int));
+
+	// Cleanup.
+	free(out);
+	free(emitted);
+	free(tri_score);
+	free(vertex_score);
+	free(cache_pos);
+	free(adjacency);
+	free(offsets);
+	free(active);
+}
+
+typedef struct {
+	int start; // First triangle.
+	int count; // Triangle count.
+	float sort_key;
+} MeshCluster;
+
+static int compare_clusters(const void *a, const void *b) {
+	float ka = ((const MeshCluster *)a)->sort_key;
+	float kb = ((const MeshCluster *)b)->sort_key;
+	return (ka < kb) - (ka > kb); // Descending.
+}
+
+// Reorder clusters of triangles so outward facing ones are drawn first and
+// occlude the rest. Clusters are split where the vertex cache is cold anyway,
+// so the vertex cache ordering inside each cluster is kept.
+void mesh_optimize_overdraw(const float *vertices, int stride, unsigned int *indices, int index_count, int vertex_count) {
+	int tri_count = index_count / 3;
+	if (tri_count == 0) {
+		return;
+	}
+
+	// Split into clusters at triangles that miss on all three vertices.
+	MeshCluster *clusters = malloc(tri_count * sizeof(MeshCluster));
+	int cluster_count = 0;
+	unsigned int *stamps = calloc(vertex_count, sizeof(unsigned int));
+	unsigned int time = MESH_CACHE_SIZE + 1;
+	for (int t = 0; t < tri_count; t++) {
+		int misses = 0;
+		for (int k = 0; k < 3; k++) {
+			unsigned int v = indices[t * 3 + k];
+			if (time - stamps[v] > MESH_CACHE_SIZE) {
+				stamps[v] = time++;
+				misses++;
+			}
+		}
+		if (t == 0 || misses == 3) {
+			clusters[cluster_count].start = t;
+			clusters[cluster_count].count = 0;
+			cluster_count++;
+		}
+		clusters[cluster_count - 1].count++;
+	}
+	free(stamps);
+
+	// Mesh centroid, used as the reference point for "outward".
+	vec3 mesh_center = {0.0f, 0.0f, 0.0f};
+	for (int i = 0; i < index_count; i++) {
+		glm_vec3_add(mesh_center, (float *)(vertices + indices[i] * stride), mesh_center);
+	}
+	glm_vec3_scale(mesh_center, 1.0f / index_count, mesh_center);
+
+	for (int c = 0; c < cluster_count; c++) {
+		vec3 center = {0.0f, 0.0f, 0.0f};
+		vec3 normal = {0.0f, 0.0f, 0.0f};
+		float area = 0.0f;
+		for (int t = clusters[c].start; t < clusters[c].start + clusters[c].count; t++) {
+			float *a = (float *)(vertices + indices[t * 3 + 0] * stride);
+			float *b = (float *)(vertices + indices[t * 3 + 1] * stride);
+			float *p = (float *)(vertices + indices[t * 3 + 2] * stride);
+			vec3 ab, ap, n, tri_center;
+			glm_vec3_sub(b, a, ab);
+			glm_vec3_sub(p, a, ap);
+			glm_vec3_cross(ab, ap, n);
+			float tri_area = glm_vec3_norm(n);
+
+			// Area weighted centroid and normal.
+			glm_vec3_add(a, b, tri_center);
+			glm_vec3_add(tri_center, p, tri_center);
+			glm_vec3_muladds(tri_center, tri_area / 3.0f, center);
+			glm_vec3_add(normal, n, normal);
+			area += tri_area;
+		}
+		if (area > 0.0f) {
+			glm_vec3_scale(center, 1.0f / area, center);
+		}
+		glm_vec3_normalize(normal);
+
+		vec3 offset;
+		glm_vec3_sub(center, mesh_center, offset);
+		clusters[c].sort_key = glm_vec3_dot(offset, normal);
+	}
+
+	qsort(clusters, cluster_count, sizeof(MeshCluster), compare_clusters);
+
+	unsigned int *out = malloc(index_count * sizeof(unsigned int));
+	int written = 0;
+	for (int c = 0; c < cluster_count; c++) {
+		memcpy(out + written, indices + clusters[c].start * 3, clusters[c].count * 3 * sizeof(unsigned int));
+		written += clusters[c].count * 3;
+	}
+	memcpy(indices, out, written * sizeof(unsigned int));
+
+	// Cleanup.
+	free(out);
+	free(clusters);
+}
+
+// Simulate a FIFO post-transform cache of `cache_size` entries.
+MeshStats mesh_analyze_vertex_cache(const unsigned int *indices, int index_count, int vertex_count, int cache_size) {
+	MeshStats stats = {0};
+	if (index_count < 3) {
+		return stats;
+	}
+
+	unsigned int *stamps = calloc(vertex_count, sizeof(unsigned int));
+	unsigned int time = cache_size + 1;
+	int misses = 0;
+	int unique = 0;
+	for (int i = 0; i < index_count; i++) {
+		unsigned int v = indices[i];
+		if (stamps[v] == 0) {
+			unique++;
+		}
+		if (time - stamps[v] > (unsigned int)cache_size) {
+			stamps[v] = time++;
+			misses++;
+		}
+	}
+	free(stamps);
+
+	stats.acmr = (float)misses / (index_count / 3);
+	stats.atvr = (float)misses / unique;
+	return stats;
+}
+
+// Everything about a mesh but its GPU buffers: counts, bounds and levels of
+// detail. Enough for culling and the software rasterizer; `vao` stays 0.
+Mesh mesh_describe(const MeshData *data) {
+	Mesh mesh = {0};
+	mesh.vertex_count = data->vertex_count;
+	mesh.index_count = data->lod_count > 0 ? data->lods[0].index_count : data->index_count;
+	mesh.lods[0].index_count = mesh.index_count;
+	mesh.lod_count = data->lod_count > 0 ? data->lod_count : 1;
+	memcpy(mesh.lods + 1, data->lods + 1, (mesh.lod_count - 1) * sizeof(MeshLod));
+	glm_aabb_invalidate(mesh.bounds);
+	for (int i = 0; i < data->vertex_count; i++) {
+		float *pos = data->vertices + i * data->stride;
+		glm_vec3_minv(mesh.bounds[0], pos, mesh.bounds[0]);
+		glm_vec3_maxv(mesh.bounds[1], pos, mesh.bounds[1]);
+	}
+	return mesh;
+}
+
+Mesh mesh_upload(const MeshData *data) {
+	Mesh mesh = mesh_describe(data);
+	glGenVertexArrays(1, &mesh.vao);
+	glGenBuffers(1, &mesh.vbo);
+	glGenBuffers(1, &mesh.ebo);
+
+	glBindVertexArray(mesh.vao);
+	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+	glBufferData(GL_ARRAY_BUFFER, data->vertex_count * data->stride * sizeof(float), data->vertices, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo); // Recorded in the VAO.
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, data->index_count * sizeof(unsigned int), data->indices, GL_STATIC_DRAW);
+
+	// Position attribute.
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, data->stride * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(0);
+
+	glBindVertexArray(0);
+	return mesh;
+}
+
+// Build an optimized, indexed mesh with its LOD chain from an unindexed triangle list.
+MeshData mesh_data_load(const char *name, const float *vertices, int vertex_count, int stride) {
+	MeshData data = mesh_data_from_vertices(vertices, vertex_count, stride);
+	MeshStats before = mesh_analyze_vertex_cache(data.indices, data.index_count, data.vertex_count, MESH_CACHE_SIZE);
+
+	mesh_optimize_vertex_cache(data.indices, data.index_count, data.vertex_count);
+	mesh_optimize_overdraw(data.vertices, data.stride, data.indices, data.index_count, data.vertex_count);
+	MeshStats after = mesh_analyze_vertex_cache(data.indices, data.index_count, data.vertex_count, MESH_CACHE_SIZE);
+
+	printf("Mesh '%s': %d triangles, %d -> %d vertices, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n",
+		name, data.index_count / 3, vertex_count, data.vertex_count,
+		before.acmr, after.acmr, before.atvr, after.atvr);
+
+	mesh_data_build_lods(&data);
+	for (int i = 1; i < data.lod_count; i++) {
+		printf("  LOD %d: %d triangles, error %.4f\n", i, data.lods[i].index_count / 3, data.lods[i].error);
+	}
+	return data;
+}
+
+// mesh_data_load() and upload, for meshes that don't need to stay on the CPU.
+Mesh mesh_load(const char *name, const float *vertices, int vertex_count, int stride) {
+	MeshData data = mesh_data_load(name, vertices, vertex_count, stride);
+	Mesh mesh = mesh_upload(&data);
+	mesh_data_free(&data);
+	return mesh;
+}
+
+void mesh_draw(const Mesh *mesh) {
+	glBindVertexArray(mesh->vao);
+	glDrawElements(GL_TRIANGLES, mesh->index_count, GL_UNSIGNED_INT, (void*)0);
+}
+
+void mesh_destroy(Mesh *mesh) {
+	glDeleteVertexArrays(1, &mesh->vao);
+	glDeleteBuffers(1, &mesh->vbo);
+	glDeleteBuffers(1, &mesh->ebo);
+	memset(mesh, 0, sizeof(*mesh));
+}
@@ -0,0 +1,62 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <cglm/cglm.h>
+
+// Post-transform vertex cache size used for optimization and statistics.
+#define MESH_CACHE_SIZE 16
+
+// Most levels of detail per mesh, including the full detail one.
+#define MESH_MAX_LODS 6
+
+// One level of detail: a range of the mesh's index list over the shared vertices.
+typedef struct {
+	int first_index;
+	int index_count;
+	float error; // Object space distance from the full detail surface.
+} MeshLod;
+
+// CPU side mesh: deduplicated vertices plus triangle index list.
+typedef struct {
+	float *vertices; // `stride` floats per vertex, position first.
+	unsigned int *indices; // Every level of detail, one after another.
+	int vertex_count;
+	int index_count;
+	int stride;
+	MeshLod lods[MESH_MAX_LODS];
+	int lod_count;
+} MeshData;
+
+// GPU side mesh, drawn with glDrawElements.
+typedef struct {
+	unsigned int vao, vbo, ebo;
+	int vertex_count;
+	int index_count; // Full detail.
+	vec3 bounds[2]; // Object space AABB, glm_aabb layout.
+	MeshLod lods[MESH_MAX_LODS];
+	int lod_count;
+} Mesh;
+
+// Post-transform vertex cache statistics for an index list.
+typedef struct {
+	float acmr; // Average cache miss ratio: transformed vertices per triangle. (0.5 - 3.0)
+	float atvr; // Average transformed to vertex ratio: transformed vertices per unique vertex. (1.0 is optimal)
+} MeshStats;
+
+MeshData mesh_data_from_vertices(const float *vertices, int vertex_count, int stride);
+void mesh_data_free(MeshData *data);
+
+void mesh_optimize_vertex_cache(unsigned int *indices, int index_count, int vertex_count);
+void mesh_optimize_overdraw(const float *vertices, int stride, unsigned int *indices, int index_count, int vertex_count);
+int mesh_simplify(const float *vertices, int stride, int vertex_count, const unsigned int *indices, int index_count, int target_index_count, unsigned int *destination, float *error);
+void mesh_data_build_lods(MeshData *data);
+MeshStats mesh_analyze_vertex_cache(const unsigned int *indices, int index_count, int vertex_count, int cache_size);
+
+MeshData mesh_data_load(const char *name, const float *vertices, int vertex_count, int stride);
+Mesh mesh_describe(const MeshData *data);
+Mesh mesh_upload(const MeshData *data);
+Mesh mesh_load(const char *name, const float *vertices, int vertex_count, int stride);
+void mesh_draw(const Mesh *mesh);
+void mesh_destroy(Mesh *mesh);
+
+#endif
@@ -0,0 +1,135 @@
+#include <glad/glad.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "occlusion.h"
+
+// Boxes this close to the camera may be clipped by the near plane and report
+// zero samples, so they always count as visible.
+#define OCCLUSION_NEAR_MARGIN 0.05f
+// Proxies are grown by this fraction about their center. A proxy the size of
+// its object lies exactly on the depth the object wrote and can fail GL_LESS
+// everywhere, culling a visible object every other frame.
+#define OCCLUSION_PROXY_GROWTH 0.01f
+
+static const char *proxy_vertex_source =
+	"#version 330 core\n"
+	"layout (location = 0) in vec3 pos;\n"
+	"uniform mat4 mvp;\n"
+	"void main() {\n"
+	"	gl_Position = mvp * vec4(pos, 1.0f);\n"
+	"}\0";
+static const char *proxy_fragment_source =
+	"#version 330 core\n"
+	"void main() {\n"
+	"}\0";
+
+OcclusionSystem occlusion_create(int capacity, const Mesh *box) {
+	OcclusionSystem occlusion = {0};
+	occlusion.capacity = capacity;
+	occlusion.box = box;
+	occlusion.queries = malloc(2 * capacity * sizeof(unsigned int));
+	occlusion.issued = malloc(capacity * sizeof(int));
+	occlusion.conditions = calloc(capacity, sizeof(unsigned int));
+	glGenQueries(2 * capacity, occlusion.queries);
+	for (int i = 0; i < capacity; i++) {
+		occlusion.issued[i] = -2; // Never queried.
+	}
+
+	occlusion.program = get_shader_program(proxy_vertex_source, proxy_fragment_source);
+	occlusion.mvp = shader_uniform(&occlusion.program, "mvp", GL_FLOAT_MAT4);
+	return occlusion;
+}
+
+// Decide which frustum visible objects to draw from last frame's queries. Objects
+// with a finished zero-sample query are dropped, ones still in flight get that
+// query in `conditions`, and the rest draw normally. Returns the drawn count.
+int occlusion_filter(OcclusionSystem *occlusion, const int *visible, int count, int *drawn) {
+	int drawn_count = 0;
+	occlusion->culled = 0;
+	occlusion->conditional = 0;
+
+	for (int v = 0; v < count; v++) {
+		int i = visible[v];
+		occlusion->conditions[i] = 0;
+		if (occlusion->issued[i] == occlusion->frame - 1) {
+			unsigned int query = occlusion->queries[2 * i + ((occlusion->frame - 1) & 1)];
+			GLuint available = 0;
+			glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (available) {
+				GLuint samples = 0;
+				glGetQueryObjectuiv(query, GL_QUERY_RESULT, &samples);
+				if (!samples) {
+					occlusion->culled++;
+					continue;
+				}
+			} else {
+				occlusion->conditions[i] = query;
+				occlusion->conditional++;
+			}
+		}
+		drawn[drawn_count++] = i;
+	}
+
+	occlusion->total_culled += occlusion->culled;
+	occlusion->frames++;
+	return drawn_count;
+}
+
+// Issue this frame's queries for the frustum visible objects against the depth
+// buffer the scene just wrote. Call after the scene is drawn; ends the frame.
+void occlusion_query(OcclusionSystem *occlusion, vec3 (*boxes)[2], const int *visible, int count, mat4 view_proj, vec3 cam_pos) {
+	occlusion->queried = 0;
+	glUseProgram(occlusion->program.id);
+	glBindVertexArray(occlusion->box->vao);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glDepthMask(GL_FALSE);
+	glDisable(GL_CULL_FACE); // Back faces still count when the front ones are hidden.
+	glDepthFunc(GL_LEQUAL);
+
+	for (int v = 0; v < count; v++) {
+		int i = visible[v];
+		vec3 near_box[2];
+		glm_vec3_subs(boxes[i][0], OCCLUSION_NEAR_MARGIN, near_box[0]);
+		glm_vec3_adds(boxes[i][1], OCCLUSION_NEAR_MARGIN, near_box[1]);
+		if (glm_aabb_point(near_box, cam_pos)) {
+			occlusion->issued[i] = -2;
+			continue;
+		}
+
+		vec3 center, size;
+		mat4 mvp;
+		glm_aabb_center(boxes[i], center);
+		glm_vec3_sub(boxes[i][1], boxes[i][0], size);
+		glm_vec3_scale(size, 1.0f + OCCLUSION_PROXY_GROWTH, size);
+		glm_translate_to(view_proj, center, mvp);
+		glm_scale(mvp, size);
+		shader_set_mat4(occlusion->mvp, mvp);
+
+		glBeginQuery(GL_ANY_SAMPLES_PASSED, occlusion->queries[2 * i + (occlusion->frame & 1)]);
+		glDrawElements(GL_TRIANGLES, occlusion->box->index_count, GL_UNSIGNED_INT, (void*)0);
+		glEndQuery(GL_ANY_SAMPLES_PASSED);
+		occlusion->issued[i] = occlusion->frame;
+		occlusion->queried++;
+	}
+
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glDepthMask(GL_TRUE);
+	glDepthFunc(GL_LESS);
+	occlusion->frame++;
+}
+
+void occlusion_report(const OcclusionSystem *occlusion) {
+	printf("Occlusion culling: %.1f objects culled per frame on average, last frame %d culled, %d conditional, %d queries\n",
+		occlusion->frames ? (double)occlusion->total_culled / occlusion->frames : 0.0,
+		occlusion->culled, occlusion->conditional, occlusion->queried);
+}
+
+void occlusion_destroy(OcclusionSystem *occlusion) {
+	glDeleteQueries(2 * occlusion->capacity, occlusion->queries);
+	free(occlusion->queries);
+	free(occlusion->issued);
+	free(occlusion->conditions);
+	shader_program_destroy(&occlusion->program);
+	memset(occlusion, 0, sizeof(*occlusion));
+}
@@ -0,0 +1,35 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <cglm/cglm.h>
+#include "mesh.h"
+#include "shader.h"
+
+// Hardware occlusion culling. Each frame the bounding boxes of frustum visible
+// objects are drawn with GL_ANY_SAMPLES_PASSED queries after the scene, and the
+// results decide next frame's draws, so nothing waits on the GPU.
+typedef struct {
+	unsigned int *queries;    // Two per object, used on alternating frames.
+	int *issued;              // Frame of each object's last query.
+	unsigned int *conditions; // Per object query for glBeginConditionalRender this frame, 0 for none.
+	int capacity;
+	int frame;
+	ShaderProgram program;
+	UniformHandle mvp;
+	const Mesh *box; // Unit cube centered on the origin.
+
+	// Last frame.
+	int culled;      // Known hidden from a finished query, not drawn at all.
+	int conditional; // Query still in flight, drawn with conditional rendering.
+	int queried;
+	long long total_culled;
+	int frames;
+} OcclusionSystem;
+
+OcclusionSystem occlusion_create(int capacity, const Mesh *box);
+int occlusion_filter(OcclusionSystem *occlusion, const int *visible, int count, int *drawn);
+void occlusion_query(OcclusionSystem *occlusion, vec3 (*boxes)[2], const int *visible, int count, mat4 view_proj, vec3 cam_pos);
+void occlusion_report(const OcclusionSystem *occlusion);
+void occlusion_destroy(OcclusionSystem *occlusion);
+
+#endif
@@ -0,0 +1,95 @@
+#include <glad/glad.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "overdraw.h"
+
+static const char *count_fragment_source =
+	"#version 330 core\n"
+	"out vec4 FragColor;\n"
+	"void main() {\n"
+	"	FragColor = vec4(1.0f);\n"
+	"}\0";
+
+static const char *heat_fragment_source =
+	"#version 330 core\n"
+	"uniform sampler2D counts;\n"
+	"out vec4 FragColor;\n"
+	"const vec3 heat[6] = vec3[](vec3(0.0f), vec3(0.0f, 0.0f, 1.0f), vec3(0.0f, 1.0f, 0.0f),\n"
+	"	vec3(1.0f, 1.0f, 0.0f), vec3(1.0f, 0.5f, 0.0f), vec3(1.0f, 0.0f, 0.0f));\n"
+	"void main() {\n"
+	"	float count = texelFetch(counts, ivec2(gl_FragCoord.xy), 0).r;\n"
+	"	FragColor = vec4(heat[int(clamp(count, 0.0f, 5.0f))], 1.0f);\n" // Black, blue, green, yellow, orange, red for 5+.
+	"}\0";
+
+// `vertex_source` is the scene's vertex shader, so positions match the normal
+// passes exactly.
+OverdrawView overdraw_create(const char *vertex_source, const FullscreenPass *fullscreen) {
+	OverdrawView overdraw = {0};
+	overdraw.fullscreen = fullscreen;
+	overdraw.count_program = get_shader_program(vertex_source, count_fragment_source);
+	overdraw.heat_program = get_shader_program(fullscreen->vertex_source, heat_fragment_source);
+	overdraw.heat_counts = shader_uniform(&overdraw.heat_program, "counts", GL_SAMPLER_2D);
+	glGenFramebuffers(1, &overdraw.fbo);
+	glGenTextures(1, &overdraw.counts);
+	glGenRenderbuffers(1, &overdraw.depth);
+	return overdraw;
+}
+
+// Redirect drawing to the counting target, sized to match the window.
+void overdraw_begin(OverdrawView *overdraw, int width, int height) {
+	if (width != overdraw->width || height != overdraw->height) {
+		overdraw->width = width;
+		overdraw->height = height;
+		glBindTexture(GL_TEXTURE_2D, overdraw->counts);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, width, height, 0, GL_RED, GL_FLOAT, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glBindRenderbuffer(GL_RENDERBUFFER, overdraw->depth);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, overdraw->fbo);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, overdraw->counts, 0);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, overdraw->depth);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			printf("Overdraw framebuffer incomplete\n");
+		}
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, overdraw->fbo);
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+// Show the counts as a heat map on the `output` framebuffer, and every
+// OVERDRAW_REPORT_FRAMES frames print the average per covered pixel.
+void overdraw_end(OverdrawView *overdraw, unsigned int output) {
+	if (++overdraw->frame % OVERDRAW_REPORT_FRAMES == 0) {
+		float *counts = malloc(overdraw->width * overdraw->height * sizeof(float));
+		glReadPixels(0, 0, overdraw->width, overdraw->height, GL_RED, GL_FLOAT, counts);
+		double fragments = 0.0;
+		int covered = 0;
+		for (int i = 0; i < overdraw->width * overdraw->height; i++) {
+			fragments += counts[i];
+			covered += counts[i] > 0.0f;
+		}
+		printf("Overdraw: %.0f fragments shaded, %.2f per covered pixel\n", fragments, covered ? fragments / covered : 0.0);
+		free(counts);
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, output);
+	glUseProgram(overdraw->heat_program.id);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, overdraw->counts);
+	shader_set_int(overdraw->heat_counts, 0);
+	fullscreen_draw(overdraw->fullscreen);
+}
+
+void overdraw_destroy(OverdrawView *overdraw) {
+	glDeleteFramebuffers(1, &overdraw->fbo);
+	glDeleteTextures(1, &overdraw->counts);
+	glDeleteRenderbuffers(1, &overdraw->depth);
+	shader_program_destroy(&overdraw->count_program);
+	shader_program_destroy(&overdraw->heat_program);
+	memset(overdraw, 0, sizeof(*overdraw));
+}
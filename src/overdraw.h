@@ -0,0 +1,31 @@
+#ifndef OVERDRAW_H
+#define OVERDRAW_H
+
+#include "fullscreen.h"
+#include "shader.h"
+
+// Frames between printed overdraw averages. Reading the counts back stalls, so
+// this is a debug mode only.
+#define OVERDRAW_REPORT_FRAMES 120
+
+// Debug view counting shaded fragments per pixel. The scene is drawn into an
+// offscreen float target with a program that adds one per fragment, then shown
+// as a heat map.
+typedef struct {
+	unsigned int fbo;
+	unsigned int counts; // GL_R16F texture.
+	unsigned int depth;  // Renderbuffer.
+	int width, height;
+	ShaderProgram count_program; // Scene vertex shader, fragment shader writes 1.
+	ShaderProgram heat_program;
+	UniformHandle heat_counts;
+	const FullscreenPass *fullscreen;
+	int frame;
+} OverdrawView;
+
+OverdrawView overdraw_create(const char *vertex_source, const FullscreenPass *fullscreen);
+void overdraw_begin(OverdrawView *overdraw, int width, int height);
+void overdraw_end(OverdrawView *overdraw, unsigned int output);
+void overdraw_destroy(OverdrawView *overdraw);
+
+#endif
@@ -0,0 +1,20 @@
+#include <stdio.h>
+#include "ppm.h"
+
+// Write 8 bit RGB pixels as a binary PPM. Rows are `row_size` bytes apart, top
+// row first, or bottom row first when `bottom_up` (as glReadPixels returns
+// them). Returns 0 if the file could not be written.
+int ppm_write(const char *path, int width, int height, const unsigned char *rgb, size_t row_size, int bottom_up) {
+	FILE *file = fopen(path, "wb");
+	if (!file) {
+		printf("Could not write %s\n", path);
+		return 0;
+	}
+	fprintf(file, "P6\n%d %d\n255\n", width, height);
+	for (int y = 0; y < height; y++) {
+		fwrite(rgb + (size_t)(bottom_up ? height - 1 - y : y) * row_size, 1, (size_t)width * 3, file);
+	}
+	int ok = !ferror(file);
+	fclose(file);
+	return ok;
+}
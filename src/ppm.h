@@ -0,0 +1,8 @@
+#ifndef PPM_H
+#define PPM_H
+
+#include <stddef.h>
+
+int ppm_write(const char *path, int width, int height, const unsigned char *rgb, size_t row_size, int bottom_up);
+
+#endif
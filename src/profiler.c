@@ -0,0 +1,198 @@
+#include <glad/glad.h>
+#include <stdio.h>
+#include <string.h>
+#include "profiler.h"
+
+// `csv_path` may be NULL to only keep averages for profiler_report().
+Profiler profiler_create(const char *csv_path) {
+	Profiler profiler = {0};
+	glGenQueries(PROFILER_FRAMES * PROFILER_MAX_SCOPES * 2, profiler.queries);
+	GLint bits = 0;
+	glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+	profiler.timestamps = bits > 0;
+	if (!profiler.timestamps) {
+		printf("GPU timestamps unsupported, timing top level passes only\n");
+	}
+
+	if (csv_path) {
+		profiler.csv = fopen(csv_path, "w");
+		if (!profiler.csv) {
+			printf("Could not open %s for profiling output\n", csv_path);
+		} else {
+			fprintf(profiler.csv, "frame,pass,depth,cpu_ms,gpu_ms\n");
+		}
+	}
+	return profiler;
+}
+
+static int find_pass(Profiler *profiler, const char *name) {
+	for (int i = 0; i < profiler->pass_count; i++) {
+		if (strcmp(profiler->passes[i].name, name) == 0) {
+			return i;
+		}
+	}
+	if (profiler->pass_count == PROFILER_MAX_PASSES) {
+		return -1;
+	}
+	ProfilerPass *pass = &profiler->passes[profiler->pass_count];
+	memset(pass, 0, sizeof(*pass));
+	pass->name = name;
+	pass->gpu_last = -1.0;
+	return profiler->pass_count++;
+}
+
+static int query_done(unsigned int query) {
+	GLuint available = 0;
+	glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+	return available != 0;
+}
+
+// GPU time of a finished scope in milliseconds, or -1 if it wasn't timed or
+// the results aren't in yet.
+static double gpu_time(const Profiler *profiler, const ProfilerScope *scope) {
+	GLuint64 begin = 0, end = 0;
+	if (!scope->timed) {
+		return -1.0;
+	}
+	if (profiler->timestamps) {
+		if (!query_done(scope->queries[1]) || !query_done(scope->queries[0])) {
+			return -1.0;
+		}
+		glGetQueryObjectui64v(scope->queries[0], GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(scope->queries[1], GL_QUERY_RESULT, &end);
+	} else {
+		if (!query_done(scope->queries[0])) {
+			return -1.0;
+		}
+		glGetQueryObjectui64v(scope->queries[0], GL_QUERY_RESULT, &end);
+	}
+	return (end - begin) / 1000000.0;
+}
+
+// Read back a frame from PROFILER_FRAMES - 1 frames ago. Scopes still not done
+// keep their CPU time and lose the GPU one.
+static void resolve(Profiler *profiler, ProfilerFrame *frame) {
+	if (!frame->pending) {
+		return;
+	}
+	frame->pending = 0;
+	int late = 0;
+	for (int i = 0; i < frame->count; i++) {
+		const ProfilerScope *scope = &frame->scopes[i];
+		ProfilerPass *pass = &profiler->passes[scope->pass];
+		double gpu_ms = gpu_time(profiler, scope);
+		late |= scope->timed && gpu_ms < 0.0;
+
+		pass->cpu_last = (scope->cpu_end - scope->cpu_begin) * 1000.0 / SDL_GetPerformanceFrequency();
+		pass->cpu_total += pass->cpu_last;
+		pass->cpu_samples++;
+		pass->gpu_last = gpu_ms;
+		if (gpu_ms >= 0.0) {
+			pass->gpu_total += gpu_ms;
+			pass->gpu_samples++;
+		}
+		if (profiler->csv) {
+			fprintf(profiler->csv, "%d,%s,%d,%.4f,%.4f\n", frame->number, pass->name, scope->depth, pass->cpu_last, gpu_ms);
+		}
+	}
+	profiler->dropped += late;
+}
+
+// Start a frame, reading back the oldest one in the ring.
+void profiler_begin_frame(Profiler *profiler) {
+	ProfilerFrame *frame = &profiler->frames[profiler->frame % PROFILER_FRAMES];
+	resolve(profiler, frame);
+	frame->count = 0;
+	frame->number = profiler->frame;
+	profiler->depth = 0;
+	profiler->overflow = 0;
+}
+
+// Open a scope timing the pass `name`, a string that outlives the profiler.
+// Scopes nest and must be closed with profiler_end() in the same frame.
+void profiler_begin(Profiler *profiler, const char *name) {
+	int slot = profiler->frame % PROFILER_FRAMES;
+	ProfilerFrame *frame = &profiler->frames[slot];
+	if (profiler->depth == PROFILER_MAX_DEPTH) {
+		profiler->overflow++;
+		return;
+	}
+	int pass = find_pass(profiler, name);
+	if (frame->count == PROFILER_MAX_SCOPES || pass < 0) {
+		profiler->stack[profiler->depth++] = -1; // Untracked, but still balanced.
+		return;
+	}
+
+	int index = frame->count++;
+	ProfilerScope *scope = &frame->scopes[index];
+	scope->pass = pass;
+	scope->depth = profiler->depth;
+	const unsigned int *queries = &profiler->queries[(slot * PROFILER_MAX_SCOPES + index) * 2];
+	scope->queries[0] = queries[0];
+	scope->queries[1] = queries[1];
+	scope->timed = profiler->timestamps || profiler->depth == 0;
+	if (scope->timed && profiler->timestamps) {
+		glQueryCounter(scope->queries[0], GL_TIMESTAMP);
+	} else if (scope->timed) {
+		glBeginQuery(GL_TIME_ELAPSED, scope->queries[0]);
+	}
+	scope->cpu_begin = SDL_GetPerformanceCounter();
+	profiler->stack[profiler->depth++] = index;
+}
+
+void profiler_end(Profiler *profiler) {
+	if (profiler->overflow > 0) {
+		profiler->overflow--;
+		return;
+	}
+	if (profiler->depth == 0) {
+		printf("profiler_end() without profiler_begin()\n");
+		return;
+	}
+	int index = profiler->stack[--profiler->depth];
+	if (index < 0) {
+		return;
+	}
+	ProfilerScope *scope = &profiler->frames[profiler->frame % PROFILER_FRAMES].scopes[index];
+	scope->cpu_end = SDL_GetPerformanceCounter();
+	if (scope->timed && profiler->timestamps) {
+		glQueryCounter(scope->queries[1], GL_TIMESTAMP);
+	} else if (scope->timed) {
+		glEndQuery(GL_TIME_ELAPSED);
+	}
+}
+
+// Close the frame. Its results are read when the ring comes back around.
+void profiler_end_frame(Profiler *profiler) {
+	while (profiler->depth > 0 || profiler->overflow > 0) {
+		printf("Profiler scope left open, closing it\n");
+		profiler_end(profiler);
+	}
+	ProfilerFrame *frame = &profiler->frames[profiler->frame % PROFILER_FRAMES];
+	frame->pending = frame->count > 0;
+	profiler->frame++;
+}
+
+void profiler_report(const Profiler *profiler) {
+	printf("Pass timings: (average ms, CPU / GPU)\n");
+	for (int i = 0; i < profiler->pass_count; i++) {
+		const ProfilerPass *pass = &profiler->passes[i];
+		printf("  %-12s %8.3f / ", pass->name, pass->cpu_samples ? pass->cpu_total / pass->cpu_samples : 0.0);
+		if (pass->gpu_samples) {
+			printf("%8.3f\n", pass->gpu_total / pass->gpu_samples);
+		} else {
+			printf("%8s\n", "-");
+		}
+	}
+	if (profiler->dropped) {
+		printf("  %d frames had GPU results too late to read\n", profiler->dropped);
+	}
+}
+
+void profiler_destroy(Profiler *profiler) {
+	glDeleteQueries(PROFILER_FRAMES * PROFILER_MAX_SCOPES * 2, profiler->queries);
+	if (profiler->csv) {
+		fclose(profiler->csv);
+	}
+	memset(profiler, 0, sizeof(*profiler));
+}
@@ -0,0 +1,61 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+
+#define PROFILER_FRAMES 4 // Frames a result may take before it is read.
+#define PROFILER_MAX_SCOPES 32 // Per frame.
+#define PROFILER_MAX_PASSES 32 // Distinct pass names.
+#define PROFILER_MAX_DEPTH 8
+
+// Timings of one named pass, in milliseconds.
+typedef struct {
+	const char *name;
+	double cpu_last, gpu_last; // gpu_last is negative when unknown.
+	double cpu_total, gpu_total;
+	int cpu_samples, gpu_samples;
+} ProfilerPass;
+
+typedef struct {
+	int pass;
+	int depth;
+	unsigned int queries[2]; // Begin and end timestamps, or one GL_TIME_ELAPSED query.
+	int timed;               // Whether the GPU was timed.
+	Uint64 cpu_begin, cpu_end;
+} ProfilerScope;
+
+typedef struct {
+	ProfilerScope scopes[PROFILER_MAX_SCOPES];
+	int count;
+	int number;
+	int pending; // Results not read yet.
+} ProfilerFrame;
+
+// Scoped CPU and GPU timer. GPU scopes are bracketed with GL_TIMESTAMP queries,
+// which nest; where timestamps have no counter bits only top level scopes are
+// timed, with GL_TIME_ELAPSED. Each frame's queries are read PROFILER_FRAMES - 1
+// frames later and dropped if still not done, so nothing ever waits on the GPU.
+typedef struct {
+	ProfilerFrame frames[PROFILER_FRAMES];
+	unsigned int queries[PROFILER_FRAMES * PROFILER_MAX_SCOPES * 2];
+	int frame;
+	ProfilerPass passes[PROFILER_MAX_PASSES];
+	int pass_count;
+	int stack[PROFILER_MAX_DEPTH];
+	int depth;
+	int overflow; // Scopes opened past PROFILER_MAX_DEPTH, not tracked.
+	int timestamps;
+	int dropped; // Frames whose GPU results were not in when read.
+	FILE *csv;   // Every resolved scope as frame,pass,depth,cpu_ms,gpu_ms, or NULL.
+} Profiler;
+
+Profiler profiler_create(const char *csv_path);
+void profiler_begin_frame(Profiler *profiler);
+void profiler_begin(Profiler *profiler, const char *name);
+void profiler_end(Profiler *profiler);
+void profiler_end_frame(Profiler *profiler);
+void profiler_report(const Profiler *profiler);
+void profiler_destroy(Profiler *profiler);
+
+#endif
@@ -0,0 +1,181 @@
+#include <glad/glad.h>
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "program_cache.h"
+
+// File header, followed by `length` bytes of binary.
+#define PROGRAM_CACHE_MAGIC 0x4e494250u // "PBIN"
+typedef struct {
+	uint32_t magic;
+	uint32_t format;
+	uint32_t length;
+	uint32_t padding;
+	uint64_t key; // Guards against hash file name collisions.
+} ProgramCacheHeader;
+
+typedef struct {
+	char *directory; // NULL while disabled.
+	int hits;
+	int misses;
+	int rejected; // Binaries the driver refused, recompiled from source.
+} ProgramCache;
+
+static ProgramCache cache;
+static PFNGLGETPROGRAMBINARYPROC get_program_binary;
+static PFNGLPROGRAMBINARYPROC program_binary;
+static PFNGLPROGRAMPARAMETERIPROC program_parameter;
+
+// Enable the cache in `directory`, which must exist (SDL_GetPrefPath() creates
+// it). Stays disabled when the driver offers no binary formats.
+void program_cache_init(const char *directory) {
+	// Core in 4.1, past the 3.3 context; glad only loads it on a 4.1+ context.
+	get_program_binary = glad_glGetProgramBinary;
+	program_binary = glad_glProgramBinary;
+	program_parameter = glad_glProgramParameteri;
+	if ((!get_program_binary || !program_binary || !program_parameter) && SDL_GL_ExtensionSupported("GL_ARB_get_program_binary")) {
+		get_program_binary = (PFNGLGETPROGRAMBINARYPROC)SDL_GL_GetProcAddress("glGetProgramBinary");
+		program_binary = (PFNGLPROGRAMBINARYPROC)SDL_GL_GetProcAddress("glProgramBinary");
+		program_parameter = (PFNGLPROGRAMPARAMETERIPROC)SDL_GL_GetProcAddress("glProgramParameteri");
+	}
+
+	int formats = 0;
+	if (get_program_binary && program_binary && program_parameter) {
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	}
+	if (formats == 0 || !directory) {
+		printf("Program binary cache disabled, the driver has no binary formats\n");
+		return;
+	}
+	cache.directory = malloc(strlen(directory) + 1);
+	strcpy(cache.directory, directory);
+}
+
+static uint64_t hash_string(uint64_t hash, const char *string) {
+	for (const unsigned char *c = (const unsigned char *)(string ? string : ""); *c; c++) {
+		hash ^= *c;
+		hash *= 1099511628211ull;
+	}
+	hash ^= 0xff; // Separator, so ("ab", "c") and ("a", "bc") differ.
+	hash *= 1099511628211ull;
+	return hash;
+}
+
+// FNV-1a over everything that can change the compiled result.
+uint64_t program_cache_key(const char *vertex_source, const char *fragment_source, const char *defines) {
+	uint64_t hash = 14695981039346656037ull;
+	hash = hash_string(hash, (const char *)glGetString(GL_VENDOR));
+	hash = hash_string(hash, (const char *)glGetString(GL_RENDERER));
+	hash = hash_string(hash, (const char *)glGetString(GL_VERSION));
+	hash = hash_string(hash, defines);
+	hash = hash_string(hash, vertex_source);
+	hash = hash_string(hash, fragment_source);
+	return hash;
+}
+
+static void entry_path(uint64_t key, char *path, size_t size) {
+	snprintf(path, size, "%sprogram_%016llx.bin", cache.directory, (unsigned long long)key);
+}
+
+// Ask the driver to keep the binary retrievable. Call before linking.
+void program_cache_prepare(unsigned int program) {
+	if (cache.directory) {
+		program_parameter(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+}
+
+// Try to fill `program` from the cache. Returns 1 when it is linked and ready;
+// on 0 the caller compiles from source as usual.
+int program_cache_load(uint64_t key, unsigned int program) {
+	if (!cache.directory) {
+		return 0;
+	}
+
+	char path[1024];
+	entry_path(key, path, sizeof(path));
+	FILE *file = fopen(path, "rb");
+	if (!file) {
+		cache.misses++;
+		return 0;
+	}
+
+	// The length is only trusted when the file really holds that many bytes, so
+	// a truncated or corrupt entry is rejected rather than allocated for.
+	long file_size = -1;
+	if (fseek(file, 0, SEEK_END) == 0) {
+		file_size = ftell(file);
+	}
+	rewind(file);
+	ProgramCacheHeader header;
+	void *binary = NULL;
+	int valid = fread(&header, sizeof(header), 1, file) == 1 && header.magic == PROGRAM_CACHE_MAGIC && header.key == key &&
+		file_size >= (long)sizeof(header) && (unsigned long)file_size - sizeof(header) == header.length;
+	if (valid) {
+		binary = malloc(header.length);
+		valid = binary && fread(binary, 1, header.length, file) == header.length;
+	}
+	fclose(file);
+
+	int linked = 0;
+	if (valid) {
+		program_binary(program, header.format, binary, header.length);
+		glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	}
+	free(binary);
+
+	if (!linked) {
+		// Stale or corrupt. Drop it; the recompiled program is stored again.
+		printf("Program binary %016llx rejected, recompiling\n", (unsigned long long)key);
+		remove(path);
+		cache.rejected++;
+		return 0;
+	}
+	cache.hits++;
+	return 1;
+}
+
+// Save a successfully linked program under `key`.
+void program_cache_store(uint64_t key, unsigned int program) {
+	if (!cache.directory) {
+		return;
+	}
+
+	ProgramCacheHeader header = {PROGRAM_CACHE_MAGIC, 0, 0, 0, key};
+	int length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) {
+		return;
+	}
+	void *binary = malloc(length);
+	GLenum format;
+	get_program_binary(program, length, NULL, &format, binary);
+	header.format = format;
+	header.length = length;
+
+	// Write a temporary file and rename it, so a crash never leaves half an entry.
+	char path[1024], temp_path[1040];
+	entry_path(key, path, sizeof(path));
+	snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+	FILE *file = fopen(temp_path, "wb");
+	if (file) {
+		int written = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(binary, 1, length, file) == (size_t)length;
+		fclose(file);
+		if (!written || rename(temp_path, path) != 0) {
+			printf("Could not write program binary %s\n", path);
+			remove(temp_path);
+		}
+	}
+	free(binary);
+}
+
+void program_cache_report(void) {
+	if (cache.directory) {
+		printf("Program binary cache: %d hits, %d misses, %d rejected\n", cache.hits, cache.misses, cache.rejected);
+	}
+}
+
+void program_cache_shutdown(void) {
+	free(cache.directory);
+	memset(&cache, 0, sizeof(cache));
+}
@@ -0,0 +1,17 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <stdint.h>
+
+// Linked program binaries saved to disk, so later launches skip compiling and
+// linking. Entries are keyed by a hash of the sources, defines and the driver's
+// vendor, renderer and version strings; a driver update changes every key.
+void program_cache_init(const char *directory);
+uint64_t program_cache_key(const char *vertex_source, const char *fragment_source, const char *defines);
+void program_cache_prepare(unsigned int program);
+int program_cache_load(uint64_t key, unsigned int program);
+void program_cache_store(uint64_t key, unsigned int program);
+void program_cache_report(void);
+void program_cache_shutdown(void);
+
+#endif
@@ -0,0 +1,183 @@
+#include <glad/glad.h>
+#include <stdlib.h>
+#include <string.h>
+#include "render_queue.h"
+
+#define MASK(bits) ((1ull << (bits)) - 1)
+
+uint64_t render_key(RenderLayer layer, unsigned int program, unsigned int material, unsigned int vao, unsigned int depth) {
+	uint64_t key = (uint64_t)(layer & MASK(RENDER_KEY_LAYER_BITS));
+	uint64_t state = (uint64_t)(program & MASK(RENDER_KEY_PROGRAM_BITS));
+	state = (state << RENDER_KEY_MATERIAL_BITS) | (material & MASK(RENDER_KEY_MATERIAL_BITS));
+	state = (state << RENDER_KEY_VAO_BITS) | (vao & MASK(RENDER_KEY_VAO_BITS));
+	depth &= MASK(RENDER_KEY_DEPTH_BITS);
+
+	if (layer >= RENDER_LAYER_TRANSPARENT) {
+		// Back to front: farthest first, state only breaks ties.
+		key = (key << RENDER_KEY_DEPTH_BITS) | (~depth & MASK(RENDER_KEY_DEPTH_BITS));
+		key = (key << (64 - RENDER_KEY_LAYER_BITS - RENDER_KEY_DEPTH_BITS)) | state;
+	} else {
+		// Front to back inside each program/material/vao run.
+		key = (key << (64 - RENDER_KEY_LAYER_BITS - RENDER_KEY_DEPTH_BITS)) | state;
+		key = (key << RENDER_KEY_DEPTH_BITS) | depth;
+	}
+	return key;
+}
+
+// Quantize a view space distance into the depth bits of a key.
+unsigned int render_depth(float view_depth, float near_z, float far_z) {
+	float t = (view_depth - near_z) / (far_z - near_z);
+	t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+	return (unsigned int)(t * MASK(RENDER_KEY_DEPTH_BITS));
+}
+
+RenderQueue render_queue_create(int capacity) {
+	RenderQueue queue = {0};
+	queue.capacity = capacity;
+	queue.packets = malloc(capacity * sizeof(DrawPacket));
+	queue.items = malloc(capacity * sizeof(RenderSortItem));
+	queue.scratch = malloc(capacity * sizeof(RenderSortItem));
+	return queue;
+}
+
+// Append a packet with `key` and return it for the caller to fill in.
+DrawPacket *render_queue_push(RenderQueue *queue, uint64_t key) {
+	if (queue->count == queue->capacity) {
+		queue->capacity = queue->capacity ? queue->capacity * 2 : 256;
+		queue->packets = realloc(queue->packets, queue->capacity * sizeof(DrawPacket));
+		queue->items = realloc(queue->items, queue->capacity * sizeof(RenderSortItem));
+		queue->scratch = realloc(queue->scratch, queue->capacity * sizeof(RenderSortItem));
+	}
+
+	DrawPacket *packet = &queue->packets[queue->count];
+	memset(packet, 0, sizeof(*packet));
+	packet->key = key;
+	queue->items[queue->count].key = key;
+	queue->items[queue->count].packet = queue->count;
+	queue->count++;
+	return packet;
+}
+
+void render_queue_clear(RenderQueue *queue) {
+	queue->count = 0;
+}
+
+// LSD radix sort of the (key, packet) items, one byte per pass. Passes where every
+// key has the same byte are skipped, which is most of them for typical scenes.
+void render_queue_sort(RenderQueue *queue) {
+	RenderSortItem *src = queue->items;
+	RenderSortItem *dst = queue->scratch;
+	int count = queue->count;
+
+	for (int shift = 0; shift < 64; shift += 8) {
+		int histogram[256] = {0};
+		for (int i = 0; i < count; i++) {
+			histogram[(src[i].key >> shift) & 0xff]++;
+		}
+		if (count == 0 || histogram[(src[0].key >> shift) & 0xff] == count) {
+			continue;
+		}
+
+		int offset = 0;
+		for (int b = 0; b < 256; b++) {
+			int n = histogram[b];
+			histogram[b] = offset;
+			offset += n;
+		}
+		for (int i = 0; i < count; i++) {
+			dst[histogram[(src[i].key >> shift) & 0xff]++] = src[i];
+		}
+
+		RenderSortItem *swap = src;
+		src = dst;
+		dst = swap;
+	}
+
+	queue->items = src;
+	queue->scratch = dst;
+}
+
+// Issue every packet in sorted order, only changing state between packets that differ.
+void render_queue_submit(RenderQueue *queue, const UboSystem *ubo, RenderPass pass) {
+	unsigned int program = 0xffffffffu;
+	unsigned int vao = 0xffffffffu;
+	int blend = -1;
+	queue->state_changes = 0;
+	if (pass == RENDER_PASS_DEPTH) {
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	}
+
+	for (int i = 0; i < queue->count; i++) {
+		const DrawPacket *packet = &queue->packets[queue->items[i].packet];
+
+		int transparent = (packet->key >> (64 - RENDER_KEY_LAYER_BITS)) >= RENDER_LAYER_TRANSPARENT;
+		if (transparent && pass == RENDER_PASS_DEPTH) {
+			break; // Layers are sorted, so only transparent ones are left.
+		}
+		if (transparent != blend) {
+			if (queue->overdraw_program) {
+				glEnable(GL_BLEND);
+				glBlendFunc(GL_ONE, GL_ONE); // Count every shaded fragment.
+			} else if (transparent) {
+				glEnable(GL_BLEND);
+				glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			} else {
+				glDisable(GL_BLEND);
+			}
+			if (transparent) {
+				glDepthFunc(GL_LESS);
+				glDepthMask(GL_FALSE); // Test against opaque depth, don't write.
+			} else {
+				// After a depth pass only the nearest fragment matches, and depth is final.
+				glDepthFunc(pass == RENDER_PASS_EQUAL ? GL_EQUAL : GL_LESS);
+				glDepthMask(pass == RENDER_PASS_EQUAL ? GL_FALSE : GL_TRUE);
+			}
+			blend = transparent;
+			queue->state_changes++;
+		}
+		unsigned int packet_program = queue->overdraw_program ? queue->overdraw_program : packet->program;
+		if (packet_program != program) {
+			glUseProgram(packet_program);
+			program = packet_program;
+			queue->state_changes++;
+		}
+		if (packet->vao != vao) {
+			glBindVertexArray(packet->vao);
+			vao = packet->vao;
+			queue->state_changes++;
+		}
+
+		glBindBufferRange(GL_UNIFORM_BUFFER, UBO_BINDING_DRAW, ubo->draw_stream.buffer, packet->draw_offset, sizeof(DrawUniforms));
+		if (packet->condition) {
+			// Draws unless the query finished with zero samples. A forward pass never
+			// waits for it. The depth and equal passes must agree, though: a query
+			// finishing between them would leave depth with no color behind it. So
+			// those have the GPU wait for the result, which was issued last frame.
+			glBeginConditionalRender(packet->condition, pass == RENDER_PASS_FORWARD ? GL_QUERY_NO_WAIT : GL_QUERY_WAIT);
+		}
+		void *first_index = (void*)(packet->first_index * sizeof(unsigned int));
+		if (packet->instance_count > 0) {
+			glDrawElementsInstanced(GL_TRIANGLES, packet->index_count, GL_UNSIGNED_INT, first_index, packet->instance_count);
+		} else {
+			glDrawElements(GL_TRIANGLES, packet->index_count, GL_UNSIGNED_INT, first_index);
+		}
+		if (packet->condition) {
+			glEndConditionalRender();
+		}
+	}
+
+	// Leave the defaults for whatever draws next.
+	if (pass == RENDER_PASS_DEPTH) {
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	}
+	glDisable(GL_BLEND);
+	glDepthFunc(GL_LESS);
+	glDepthMask(GL_TRUE);
+}
+
+void render_queue_destroy(RenderQueue *queue) {
+	free(queue->packets);
+	free(queue->items);
+	free(queue->scratch);
+	memset(queue, 0, sizeof(*queue));
+}
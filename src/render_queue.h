@@ -0,0 +1,68 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <stdint.h>
+#include "ubo.h"
+
+// Layers draw in order. Layers from RENDER_LAYER_TRANSPARENT on are blended and
+// sorted back to front; the ones before it front to back.
+typedef enum {
+	RENDER_LAYER_OPAQUE,
+	RENDER_LAYER_TRANSPARENT,
+	RENDER_LAYER_COUNT
+} RenderLayer;
+
+// How a submit treats depth. RENDER_PASS_DEPTH lays down opaque depth only, and
+// RENDER_PASS_EQUAL then shades just the fragments that won it.
+typedef enum {
+	RENDER_PASS_FORWARD,
+	RENDER_PASS_DEPTH,
+	RENDER_PASS_EQUAL
+} RenderPass;
+
+// Sort key bit widths. Opaque keys are layer|program|material|vao|depth so state
+// changes are minimized first; transparent keys are layer|~depth|program|material|vao.
+#define RENDER_KEY_LAYER_BITS 4
+#define RENDER_KEY_PROGRAM_BITS 10
+#define RENDER_KEY_MATERIAL_BITS 12
+#define RENDER_KEY_VAO_BITS 14
+#define RENDER_KEY_DEPTH_BITS 24
+
+// Everything needed to issue one draw.
+typedef struct {
+	uint64_t key;
+	unsigned int program;
+	unsigned int vao;
+	unsigned int draw_offset; // Byte offset of this draw's DrawUniforms in the UBO ring.
+	int first_index;          // Into the VAO's element buffer, for levels of detail.
+	int index_count;
+	int instance_count;       // 0 for a plain, non-instanced draw.
+	unsigned int condition;   // Occlusion query for glBeginConditionalRender, 0 to always draw.
+} DrawPacket;
+
+typedef struct {
+	uint64_t key;
+	int packet;
+} RenderSortItem;
+
+typedef struct {
+	DrawPacket *packets;
+	RenderSortItem *items;
+	RenderSortItem *scratch;
+	int count;
+	int capacity;
+	int state_changes; // Program, VAO and blend changes in the last submit.
+	unsigned int overdraw_program; // Draw everything with this additively blended program instead, 0 for none.
+} RenderQueue;
+
+uint64_t render_key(RenderLayer layer, unsigned int program, unsigned int material, unsigned int vao, unsigned int depth);
+unsigned int render_depth(float view_depth, float near_z, float far_z);
+
+RenderQueue render_queue_create(int capacity);
+DrawPacket *render_queue_push(RenderQueue *queue, uint64_t key);
+void render_queue_clear(RenderQueue *queue);
+void render_queue_sort(RenderQueue *queue);
+void render_queue_submit(RenderQueue *queue, const UboSystem *ubo, RenderPass pass);
+void render_queue_destroy(RenderQueue *queue);
+
+#endif
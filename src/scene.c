@@ -0,0 +1,163 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "scene.h"
+
+// A single object at the origin, or `count` objects filling a unit cube grid.
+Scene scene_create(int count, const Mesh *mesh, unsigned int program) {
+	Scene scene = {0};
+	scene.count = count;
+	scene.mesh = mesh;
+	scene.program = program;
+	scene.models = malloc(count * sizeof(mat4));
+	scene.bounds = cull_set_create(count);
+	scene.boxes = malloc(count * sizeof(*scene.boxes));
+	scene.lods = calloc(count, 1);
+
+	int side = (int)ceil(cbrt(count));
+	float spacing = 1.0f / side;
+	for (int i = 0; i < count; i++) {
+		glm_mat4_identity(scene.models[i]);
+		if (count > 1) {
+			vec3 pos = {
+				(i % side) * spacing - 0.5f,
+				(i / side % side) * spacing - 0.5f,
+				(i / (side * side)) * spacing - 0.5f
+			};
+			glm_translate(scene.models[i], pos);
+			glm_scale_uni(scene.models[i], spacing * 0.5f);
+		}
+
+		glm_aabb_transform((vec3 *)mesh->bounds, scene.models[i], scene.boxes[i]);
+		cull_set_add_aabb(&scene.bounds, scene.boxes[i]);
+	}
+	scene.bvh = bvh_build(scene.boxes, count);
+
+	return scene;
+}
+
+// Frustum cull every object. Writes visible object indices and returns their count.
+int scene_cull(const Scene *scene, mat4 view_proj, int *visible) {
+	vec4 planes[6];
+	glm_frustum_planes(view_proj, planes);
+	return cull_frustum_aabbs(&scene->bounds, planes, visible);
+}
+
+// Pick the visible objects nearest the camera as occluders, nearest first. Every
+// object is the same size, so these hide the most. Returns how many were picked.
+int scene_occluders(const Scene *scene, const int *visible, int count, vec3 cam_pos, int occluders[SCENE_MAX_OCCLUDERS]) {
+	float distances[SCENE_MAX_OCCLUDERS];
+	int picked = 0;
+	for (int v = 0; v < count; v++) {
+		int i = visible[v];
+		float distance = glm_vec3_distance2(cam_pos, scene->models[i][3]);
+		if (picked == SCENE_MAX_OCCLUDERS && distance >= distances[picked - 1]) {
+			continue;
+		}
+
+		// Insertion into the sorted list, dropping the farthest when full.
+		int slot = picked < SCENE_MAX_OCCLUDERS ? picked++ : picked - 1;
+		while (slot > 0 && distances[slot - 1] > distance) {
+			distances[slot] = distances[slot - 1];
+			occluders[slot] = occluders[slot - 1];
+			slot--;
+		}
+		distances[slot] = distance;
+		occluders[slot] = i;
+	}
+	return picked;
+}
+
+typedef struct {
+	const Scene *scene;
+	const MeshBvh *mesh_bvh;
+} ScenePick;
+
+// BvhHitFn: move the ray into object space and test the mesh's triangles. The
+// direction isn't renormalized, so distances stay in world units.
+static float pick_object(void *data, int object, vec3 origin, vec3 dir) {
+	ScenePick *pick = data;
+	mat4 inverse;
+	vec3 local_origin, local_dir;
+	glm_mat4_inv(pick->scene->models[object], inverse);
+	glm_mat4_mulv3(inverse, origin, 1.0f, local_origin);
+	glm_mat4_mulv3(inverse, dir, 0.0f, local_dir);
+
+	float distance;
+	return mesh_bvh_raycast(pick->mesh_bvh, local_origin, local_dir, &distance) >= 0 ? distance : -1.0f;
+}
+
+// Closest object hit by a world space ray, or -1. Every object shares `mesh_bvh`.
+int scene_pick(const Scene *scene, const MeshBvh *mesh_bvh, vec3 origin, vec3 dir, float *distance) {
+	ScenePick pick = {scene, mesh_bvh};
+	return bvh_raycast(&scene->bvh, origin, dir, pick_object, &pick, distance);
+}
+
+// Level of detail for object `i` from its screen space error. The bounding sphere
+// is projected to get pixels per object space unit, which scales each level's
+// error. Starts from the object's last level and only moves once the error is
+// clearly past the threshold.
+int scene_select_lod(const Scene *scene, const SceneView *view, int i) {
+	const Mesh *mesh = scene->mesh;
+	vec3 center = {scene->bounds.center[0][i], scene->bounds.center[1][i], scene->bounds.center[2][i]};
+	float radius = scene->bounds.radius[i];
+	if (mesh->lod_count == 1 || glm_vec3_distance(center, (float *)view->cam_pos) <= radius) {
+		return 0; // Camera inside the sphere, the projection is meaningless.
+	}
+
+	vec3 edge, screen_center, screen_edge;
+	glm_vec3_copy(center, edge);
+	glm_vec3_muladds((float *)view->cam_up, radius, edge);
+	glm_project(center, (vec4 *)view->view_proj, (float *)view->viewport, screen_center);
+	glm_project(edge, (vec4 *)view->view_proj, (float *)view->viewport, screen_edge);
+	float pixels = glm_vec2_distance(screen_center, screen_edge) / glm_aabb_radius((vec3 *)mesh->bounds);
+
+	int lod = scene->lods[i] < mesh->lod_count ? scene->lods[i] : mesh->lod_count - 1;
+	while (lod > 0 && mesh->lods[lod].error * pixels > SCENE_LOD_ERROR_PIXELS * (1.0f + SCENE_LOD_HYSTERESIS)) {
+		lod--;
+	}
+	while (lod + 1 < mesh->lod_count && mesh->lods[lod + 1].error * pixels < SCENE_LOD_ERROR_PIXELS * (1.0f - SCENE_LOD_HYSTERESIS)) {
+		lod++;
+	}
+	return lod;
+}
+
+// RecordFn for one bucket of the visible objects. Safe to run on any thread.
+void scene_record_bucket(CommandList *list, int bucket, void *data) {
+	const SceneView *view = data;
+	const Scene *scene = view->scene;
+	int begin = (int)((long long)view->visible_count * bucket / view->bucket_count);
+	int end = (int)((long long)view->visible_count * (bucket + 1) / view->bucket_count);
+
+	DrawCommand command = {0};
+	command.program = scene->program;
+	command.vao = scene->mesh->vao;
+	command.instance_count = 1; // Identity instance, the model comes from the Draw block.
+	int triangles = 0;
+
+	DrawUniforms uniforms = {GLM_MAT4_IDENTITY_INIT, {1.0f, 0.0f, 0.0f, 0.5f}}; // Red, half specular.
+	for (int v = begin; v < end; v++) {
+		int i = view->visible[v];
+		float depth = glm_vec3_distance((float *)view->cam_pos, scene->models[i][3]);
+		command.key = render_key(RENDER_LAYER_OPAQUE, command.program, 0, command.vao,
+			render_depth(depth, view->near_z, view->far_z));
+		int lod = scene_select_lod(scene, view, i);
+		scene->lods[i] = (unsigned char)lod; // Each object is in exactly one bucket.
+		command.first_index = scene->mesh->lods[lod].first_index;
+		command.index_count = scene->mesh->lods[lod].index_count;
+		triangles += command.index_count / 3;
+		command.condition = view->conditions ? view->conditions[i] : 0;
+		glm_mat4_copy(scene->models[i], uniforms.model);
+		command_list_draw(list, &command, &uniforms);
+	}
+	view->bucket_triangles[bucket] = triangles;
+}
+
+void scene_destroy(Scene *scene) {
+	free(scene->models);
+	cull_set_destroy(&scene->bounds);
+	free(scene->boxes);
+	free(scene->lods);
+	bvh_destroy(&scene->bvh);
+	memset(scene, 0, sizeof(*scene));
+}
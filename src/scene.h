@@ -0,0 +1,53 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <cglm/cglm.h>
+#include "mesh.h"
+#include "command_list.h"
+#include "cull.h"
+#include "bvh.h"
+
+// Most objects rasterized as occluders for software occlusion culling per frame.
+#define SCENE_MAX_OCCLUDERS 16
+
+// Screen space error, in pixels, a level of detail may have. Switching needs the
+// error to be this fraction past the threshold, so objects near it don't flicker.
+#define SCENE_LOD_ERROR_PIXELS 1.0f
+#define SCENE_LOD_HYSTERESIS 0.25f
+
+// Objects in the world. Every object draws `mesh` with `program` for now.
+typedef struct {
+	mat4 *models;
+	int count;
+	const Mesh *mesh;
+	unsigned int program;
+	CullSet bounds; // World space AABB of each object.
+	vec3 (*boxes)[2]; // The same boxes in glm_aabb layout, for refitting `bvh`.
+	unsigned char *lods; // Level of detail each object was last drawn with.
+	Bvh bvh;
+} Scene;
+
+// What a frame's recording needs to know about the camera.
+typedef struct {
+	const Scene *scene;
+	const int *visible; // Indices of objects that passed culling.
+	int visible_count;
+	const unsigned int *conditions; // Per object conditional render query, or NULL.
+	vec3 cam_pos;
+	float near_z, far_z;
+	int bucket_count; // Visible objects are split into this many contiguous buckets.
+	mat4 view_proj;
+	vec4 viewport;
+	vec3 cam_up; // World space, for projecting bounding spheres.
+	int *bucket_triangles; // Triangles recorded by each bucket.
+} SceneView;
+
+Scene scene_create(int count, const Mesh *mesh, unsigned int program);
+int scene_cull(const Scene *scene, mat4 view_proj, int *visible);
+int scene_occluders(const Scene *scene, const int *visible, int count, vec3 cam_pos, int occluders[SCENE_MAX_OCCLUDERS]);
+int scene_select_lod(const Scene *scene, const SceneView *view, int object);
+int scene_pick(const Scene *scene, const MeshBvh *mesh_bvh, vec3 origin, vec3 dir, float *distance);
+void scene_record_bucket(CommandList *list, int bucket, void *view);
+void scene_destroy(Scene *scene);
+
+#endif
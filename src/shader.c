@@ -0,0 +1,482 @@
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "shader.h"
+#include "program_cache.h"
+
+// Readable GLSL name of a reflected type, for error messages.
+static const char *type_name(GLenum type) {
+	switch (type) {
+		case GL_FLOAT: return "float";
+		case GL_FLOAT_VEC2: return "vec2";
+		case GL_FLOAT_VEC3: return "vec3";
+		case GL_FLOAT_VEC4: return "vec4";
+		case GL_INT: return "int";
+		case GL_UNSIGNED_INT: return "uint";
+		case GL_FLOAT_MAT3: return "mat3";
+		case GL_FLOAT_MAT4: return "mat4";
+		case GL_SAMPLER_2D: return "sampler2D";
+		case GL_SAMPLER_2D_SHADOW: return "sampler2DShadow";
+		case GL_SAMPLER_2D_ARRAY: return "sampler2DArray";
+		case GL_SAMPLER_2D_ARRAY_SHADOW: return "sampler2DArrayShadow";
+		case GL_SAMPLER_BUFFER: return "samplerBuffer";
+		case GL_UNSIGNED_INT_SAMPLER_BUFFER: return "usamplerBuffer";
+		default: return "unknown";
+	}
+}
+
+// KHR_parallel_shader_compile and its ARB twin share the enum value.
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+// Whether GL_COMPLETION_STATUS_KHR can be queried. The first call also lets the
+// driver use as many compiler threads as it likes.
+int shader_parallel_compile(void) {
+	static int loaded = 0;
+	static int supported = 0;
+	if (!loaded) {
+		loaded = 1;
+		PFNGLMAXSHADERCOMPILERTHREADSKHRPROC max_threads = NULL;
+		if (SDL_GL_ExtensionSupported("GL_KHR_parallel_shader_compile")) {
+			max_threads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)SDL_GL_GetProcAddress("glMaxShaderCompilerThreadsKHR");
+		} else if (SDL_GL_ExtensionSupported("GL_ARB_parallel_shader_compile")) {
+			max_threads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)SDL_GL_GetProcAddress("glMaxShaderCompilerThreadsARB");
+		}
+		if (max_threads) {
+			max_threads(0xFFFFFFFF);
+			supported = 1;
+		}
+	}
+	return supported;
+}
+
+// Submit a compile. The status is only checked once the program is finished,
+// querying it here would wait for the compiler.
+static unsigned int compile_shader(GLenum type, const char *source) {
+	unsigned int shader = glCreateShader(type);
+	glShaderSource(shader, 1, &source, NULL);
+	glCompileShader(shader);
+	return shader;
+}
+
+static void check_shader(unsigned int shader, const char *stage) {
+	int success, log_length;
+
+	// Check for error compiling shader.
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+	if (!success) {
+		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &log_length);
+		char *log = malloc(log_length + 1);
+		glGetShaderInfoLog(shader, log_length + 1, NULL, log);
+		printf("%s shader could not be compiled!\n", stage);
+		printf("%s shader ERROR: %s\n", stage, log);
+		free(log);
+	}
+}
+
+static char *read_file(const char *path) {
+	FILE *file = fopen(path, "rb");
+	if (!file) {
+		return NULL;
+	}
+	fseek(file, 0, SEEK_END);
+	long length = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	char *source = malloc(length + 1);
+	length = (long)fread(source, 1, length, file);
+	source[length] = '\0';
+	fclose(file);
+	return source;
+}
+
+// Growing output of the preprocessor.
+typedef struct {
+	char *data;
+	size_t length;
+	size_t capacity;
+	int file_count; // Source string numbers handed out by #line.
+	char **includes; // Names of included files, one per line. May be NULL.
+	char *loaded;    // Paths of files already included, one per line.
+} SourceBuffer;
+
+// Append a line to a malloc'd list of lines, which may start out NULL.
+static void append_name(char **list, const char *name, int length) {
+	size_t used = *list ? strlen(*list) : 0;
+	*list = realloc(*list, used + length + 2);
+	memcpy(*list + used, name, length);
+	(*list)[used + length] = '\n';
+	(*list)[used + length + 1] = '\0';
+}
+
+static int has_name(const char *list, const char *name) {
+	size_t length = strlen(name);
+	for (const char *line = list; line && *line; line = strchr(line, '\n') + 1) {
+		if (strncmp(line, name, length) == 0 && line[length] == '\n') {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void append(SourceBuffer *buffer, const char *text, size_t length) {
+	if (buffer->length + length + 1 > buffer->capacity) {
+		buffer->capacity = (buffer->length + length + 1) * 2;
+		buffer->data = realloc(buffer->data, buffer->capacity);
+	}
+	memcpy(buffer->data + buffer->length, text, length);
+	buffer->length += length;
+	buffer->data[buffer->length] = '\0';
+}
+
+static void append_line_directive(SourceBuffer *buffer, int line, int file) {
+	char directive[32];
+	int length = snprintf(directive, sizeof(directive), "#line %d %d\n", line, file);
+	append(buffer, directive, length);
+}
+
+// Copy `path` into `buffer`, replacing every #include "name" line with the named
+// file, relative to the including one. Each file is included once per load, so
+// shared headers can be included wherever they are needed. Included files get
+// their own source string number in #line, so compile errors point at the right
+// file and line.
+static int preprocess(SourceBuffer *buffer, const char *path, int depth) {
+	if (depth > SHADER_INCLUDE_DEPTH) {
+		printf("Shader includes nested too deep at %s\n", path);
+		return 0;
+	}
+	char *source = read_file(path);
+	if (!source) {
+		printf("Could not open shader source %s\n", path);
+		return 0;
+	}
+
+	int file = buffer->file_count++;
+	if (depth > 0) {
+		append_line_directive(buffer, 1, file);
+	}
+	int success = 1;
+	int line = 1;
+	for (char *start = source; *start && success; line++) {
+		char *end = strchr(start, '\n');
+		size_t length = end ? (size_t)(end + 1 - start) : strlen(start);
+		const char *directive = start + strspn(start, " \t");
+		if (strncmp(directive, "#include", 8) != 0) {
+			append(buffer, start, length);
+			start += length;
+			continue;
+		}
+
+		const char *open = strchr(directive, '"');
+		const char *close = open ? strchr(open + 1, '"') : NULL;
+		if (!close || (end && close > end)) {
+			printf("%s:%d: malformed #include\n", path, line);
+			success = 0;
+			break;
+		}
+		char include_path[SHADER_PATH_LENGTH];
+		const char *slash = strrchr(path, '/');
+		int directory_length = slash ? (int)(slash + 1 - path) : 0;
+		int written = snprintf(include_path, sizeof(include_path), "%.*s%.*s", directory_length, path, (int)(close - open - 1), open + 1);
+		if (written >= (int)sizeof(include_path)) {
+			printf("%s:%d: include path too long\n", path, line);
+			success = 0;
+			break;
+		}
+		start += length;
+		if (has_name(buffer->loaded, include_path)) {
+			append(buffer, "\n", 1); // Keep the line numbering.
+			continue;
+		}
+		append_name(&buffer->loaded, include_path, written);
+		if (buffer->includes) {
+			append_name(buffer->includes, open + 1, (int)(close - open - 1));
+		}
+		success = preprocess(buffer, include_path, depth + 1);
+		append_line_directive(buffer, line + 1, file);
+	}
+
+	free(source);
+	return success;
+}
+
+// Read a shader source file and resolve its #includes. The names of included
+// files are appended to the malloc'd list `*includes`, one per line, unless
+// `includes` is NULL. Returns a malloc'd string, or NULL.
+char *shader_source_load(const char *path, char **includes) {
+	SourceBuffer buffer = {0};
+	buffer.includes = includes;
+	append(&buffer, "", 0);
+	int success = preprocess(&buffer, path, 0);
+	free(buffer.loaded);
+	if (!success) {
+		free(buffer.data);
+		return NULL;
+	}
+	return buffer.data;
+}
+
+// Insert `defines` (lines of "#define NAME VALUE") right after the #version
+// line, which GLSL requires to come first, and restore the line numbering
+// after them. Returns a malloc'd copy.
+static char *inject_defines(const char *source, const char *defines) {
+	const char *version = strstr(source, "#version");
+	const char *line_end = version ? strchr(version, '\n') : NULL;
+	size_t split = line_end ? (size_t)(line_end + 1 - source) : 0;
+	int line = 1;
+	for (size_t i = 0; i < split; i++) {
+		line += source[i] == '\n';
+	}
+
+	SourceBuffer buffer = {0};
+	append(&buffer, source, split);
+	append(&buffer, defines, strlen(defines));
+	if (buffer.length > 0 && buffer.data[buffer.length - 1] != '\n') {
+		append(&buffer, "\n", 1);
+	}
+	append_line_directive(&buffer, line, 0);
+	append(&buffer, source + split, strlen(source + split));
+	return buffer.data;
+}
+
+// Start building a program from source with optional `defines` (NULL for none).
+// A binary from the program cache is used when one matches; otherwise compile
+// and link are submitted without waiting for either.
+ShaderBuild shader_build_begin(const char *vertex_source, const char *fragment_source, const char *defines) {
+	ShaderBuild build = {0};
+	char *vertex = defines ? inject_defines(vertex_source, defines) : NULL;
+	char *fragment = defines ? inject_defines(fragment_source, defines) : NULL;
+	if (vertex) {
+		vertex_source = vertex;
+		fragment_source = fragment;
+	}
+
+	build.program.id = glCreateProgram();
+	build.key = program_cache_key(vertex_source, fragment_source, defines);
+	build.program.linked = program_cache_load(build.key, build.program.id);
+	if (!build.program.linked) {
+		// A rejected binary may leave the program in a failed state, start over.
+		glDeleteProgram(build.program.id);
+		build.program.id = glCreateProgram();
+		program_cache_prepare(build.program.id);
+		build.vertex_shader = compile_shader(GL_VERTEX_SHADER, vertex_source);
+		build.fragment_shader = compile_shader(GL_FRAGMENT_SHADER, fragment_source);
+		glAttachShader(build.program.id, build.vertex_shader);
+		glAttachShader(build.program.id, build.fragment_shader);
+		glLinkProgram(build.program.id);
+	}
+
+	free(vertex);
+	free(fragment);
+	return build;
+}
+
+// Whether shader_build_finish() would return without waiting. Without
+// KHR_parallel_shader_compile there is no way to tell, so this is always true.
+int shader_build_ready(const ShaderBuild *build) {
+	if (!build->vertex_shader || !shader_parallel_compile()) {
+		return 1;
+	}
+	int complete = 0;
+	glGetProgramiv(build->program.id, GL_COMPLETION_STATUS_KHR, &complete);
+	return complete;
+}
+
+// Check the results of a build, report errors and store the binary of a newly
+// linked program. Returns the program, reflected if it linked.
+ShaderProgram shader_build_finish(ShaderBuild *build) {
+	ShaderProgram program = build->program;
+	int success, log_length;
+
+	if (build->vertex_shader) {
+		glGetProgramiv(program.id, GL_LINK_STATUS, &success);
+		if (!success) {
+			check_shader(build->vertex_shader, "Vertex");
+			check_shader(build->fragment_shader, "Fragment");
+			glGetProgramiv(program.id, GL_INFO_LOG_LENGTH, &log_length);
+			char *log = malloc(log_length + 1);
+			glGetProgramInfoLog(program.id, log_length + 1, NULL, log);
+			printf("Error linking shaders with shader_program\n");
+			printf("Link ERROR: %s\n", log);
+			free(log);
+		} else {
+			program_cache_store(build->key, program.id);
+		}
+
+		// Cleanup.
+		glDetachShader(program.id, build->vertex_shader);
+		glDetachShader(program.id, build->fragment_shader);
+		glDeleteShader(build->vertex_shader);
+		glDeleteShader(build->fragment_shader);
+		program.linked = success;
+	}
+
+	if (program.linked) {
+		shader_reflect(&program);
+	}
+	memset(build, 0, sizeof(*build));
+	return program;
+}
+
+// Drop a build that is no longer wanted without waiting for it: nothing is
+// queried, so an unfinished compile or link is just abandoned.
+void shader_build_discard(ShaderBuild *build) {
+	if (build->vertex_shader) {
+		glDetachShader(build->program.id, build->vertex_shader);
+		glDetachShader(build->program.id, build->fragment_shader);
+		glDeleteShader(build->vertex_shader);
+		glDeleteShader(build->fragment_shader);
+	}
+	glDeleteProgram(build->program.id);
+	memset(build, 0, sizeof(*build));
+}
+
+// Build a program and wait for it.
+ShaderProgram shader_program_create(const char *vertex_source, const char *fragment_source, const char *defines) {
+	ShaderBuild build = shader_build_begin(vertex_source, fragment_source, defines);
+	return shader_build_finish(&build);
+}
+
+ShaderProgram get_shader_program(const char *vertex_source, const char *fragment_source) {
+	return shader_program_create(vertex_source, fragment_source, NULL);
+}
+
+// Strip the "[0]" GL appends to array names.
+static void strip_array_suffix(char *name) {
+	char *bracket = strchr(name, '[');
+	if (bracket) {
+		*bracket = '\0';
+	}
+}
+
+// Introspect active uniforms, attributes and uniform blocks of a linked program.
+void shader_reflect(ShaderProgram *program) {
+	int count;
+
+	glGetProgramiv(program->id, GL_ACTIVE_UNIFORMS, &count);
+	program->uniforms = calloc(count, sizeof(ShaderVariable));
+	program->uniform_count = 0;
+	for (int i = 0; i < count; i++) {
+		ShaderVariable *uniform = &program->uniforms[program->uniform_count];
+		glGetActiveUniform(program->id, i, SHADER_NAME_LENGTH, NULL, &uniform->size, &uniform->type, uniform->name);
+		uniform->location = glGetUniformLocation(program->id, uniform->name);
+		if (uniform->location == -1) {
+			continue; // Member of a uniform block.
+		}
+		strip_array_suffix(uniform->name);
+		program->uniform_count++;
+	}
+
+	glGetProgramiv(program->id, GL_ACTIVE_ATTRIBUTES, &count);
+	program->attribs = calloc(count, sizeof(ShaderVariable));
+	program->attrib_count = 0;
+	for (int i = 0; i < count; i++) {
+		ShaderVariable *attrib = &program->attribs[program->attrib_count];
+		glGetActiveAttrib(program->id, i, SHADER_NAME_LENGTH, NULL, &attrib->size, &attrib->type, attrib->name);
+		attrib->location = glGetAttribLocation(program->id, attrib->name);
+		if (attrib->location == -1) {
+			continue; // Built-in such as gl_VertexID.
+		}
+		strip_array_suffix(attrib->name);
+		program->attrib_count++;
+	}
+
+	glGetProgramiv(program->id, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+	program->blocks = calloc(count, sizeof(ShaderBlock));
+	program->block_count = count;
+	for (int i = 0; i < count; i++) {
+		ShaderBlock *block = &program->blocks[i];
+		glGetActiveUniformBlockName(program->id, i, SHADER_NAME_LENGTH, NULL, block->name);
+		glGetActiveUniformBlockiv(program->id, i, GL_UNIFORM_BLOCK_DATA_SIZE, &block->data_size);
+		block->index = i;
+	}
+}
+
+void shader_program_destroy(ShaderProgram *program) {
+	glDeleteProgram(program->id);
+	free(program->uniforms);
+	free(program->attribs);
+	free(program->blocks);
+	memset(program, 0, sizeof(*program));
+}
+
+static const ShaderVariable *find_variable(const ShaderVariable *variables, int count, const char *name) {
+	for (int i = 0; i < count; i++) {
+		if (strcmp(variables[i].name, name) == 0) {
+			return &variables[i];
+		}
+	}
+	return NULL;
+}
+
+const ShaderBlock *shader_find_block(const ShaderProgram *program, const char *name) {
+	for (int i = 0; i < program->block_count; i++) {
+		if (strcmp(program->blocks[i].name, name) == 0) {
+			return &program->blocks[i];
+		}
+	}
+	return NULL;
+}
+
+// Resolve a uniform the C side expects to be of `type`. Inactive or mismatched
+// uniforms get location -1, which GL silently ignores.
+UniformHandle shader_uniform(const ShaderProgram *program, const char *name, GLenum type) {
+	UniformHandle handle = {-1, type};
+	const ShaderVariable *uniform = find_variable(program->uniforms, program->uniform_count, name);
+	if (!uniform) {
+		printf("Uniform '%s' is not active in program %u\n", name, program->id);
+		return handle;
+	}
+	if (uniform->type != type) {
+		printf("Uniform '%s' type mismatch! C expects %s, GLSL declares %s\n", name, type_name(type), type_name(uniform->type));
+		return handle;
+	}
+
+	handle.location = uniform->location;
+	return handle;
+}
+
+int shader_check_attrib(const ShaderProgram *program, const char *name, int location, GLenum type) {
+	const ShaderVariable *attrib = find_variable(program->attribs, program->attrib_count, name);
+	if (!attrib) {
+		printf("Attribute '%s' is not active in program %u\n", name, program->id);
+		return 0;
+	}
+	if (attrib->type != type || attrib->location != location) {
+		printf("Attribute '%s' mismatch! C expects %s at location %d, GLSL declares %s at location %d\n",
+			name, type_name(type), location, type_name(attrib->type), attrib->location);
+		return 0;
+	}
+	return 1;
+}
+
+// Check a uniform block against the size of the C struct mirroring it.
+int shader_check_block(const ShaderProgram *program, const char *name, int size) {
+	const ShaderBlock *block = shader_find_block(program, name);
+	if (!block) {
+		return 1; // Not used by this program.
+	}
+	if (block->data_size != size) {
+		printf("Uniform block '%s' size mismatch! C struct is %d bytes, GLSL block is %d bytes\n", name, size, block->data_size);
+		return 0;
+	}
+	return 1;
+}
+
+void shader_set_int(UniformHandle uniform, int value) {
+	glUniform1i(uniform.location, value);
+}
+
+void shader_set_float(UniformHandle uniform, float value) {
+	glUniform1f(uniform.location, value);
+}
+
+void shader_set_vec4(UniformHandle uniform, vec4 value) {
+	glUniform4fv(uniform.location, 1, value);
+}
+
+void shader_set_mat4(UniformHandle uniform, mat4 value) {
+	glUniformMatrix4fv(uniform.location, 1, GL_FALSE, (float *)value);
+}
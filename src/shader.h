@@ -0,0 +1,74 @@
+#ifndef SHADER_H
+#define SHADER_H
+
+#include <glad/glad.h>
+#include <cglm/cglm.h>
+#include <stdint.h>
+
+#define SHADER_NAME_LENGTH 64
+#define SHADER_PATH_LENGTH 256
+#define SHADER_INCLUDE_DEPTH 8
+
+// Active uniform or vertex attribute, as reported after link.
+typedef struct {
+	char name[SHADER_NAME_LENGTH]; // Arrays without the "[0]" suffix.
+	GLenum type;
+	int size; // Array length, 1 for non-arrays.
+	int location;
+} ShaderVariable;
+
+typedef struct {
+	char name[SHADER_NAME_LENGTH];
+	unsigned int index;
+	int data_size; // Bytes, as laid out by the block's layout qualifier.
+} ShaderBlock;
+
+// Linked program plus everything introspected from it once after link, so
+// nothing is looked up by name while drawing.
+typedef struct {
+	unsigned int id;
+	int linked;
+	ShaderVariable *uniforms; // Default block uniforms only.
+	int uniform_count;
+	ShaderVariable *attribs;
+	int attrib_count;
+	ShaderBlock *blocks;
+	int block_count;
+} ShaderProgram;
+
+// Program whose compile and link were submitted but not checked yet.
+typedef struct {
+	ShaderProgram program;
+	unsigned int vertex_shader; // 0 when loaded from the program cache.
+	unsigned int fragment_shader;
+	uint64_t key; // Program cache key.
+} ShaderBuild;
+
+// Uniform location resolved and type checked at load time.
+typedef struct {
+	int location;
+	GLenum type;
+} UniformHandle;
+
+char *shader_source_load(const char *path, char **includes);
+int shader_parallel_compile(void);
+ShaderBuild shader_build_begin(const char *vertex_source, const char *fragment_source, const char *defines);
+int shader_build_ready(const ShaderBuild *build);
+ShaderProgram shader_build_finish(ShaderBuild *build);
+void shader_build_discard(ShaderBuild *build);
+ShaderProgram shader_program_create(const char *vertex_source, const char *fragment_source, const char *defines);
+ShaderProgram get_shader_program(const char *vertex_source, const char *fragment_source);
+void shader_reflect(ShaderProgram *program);
+void shader_program_destroy(ShaderProgram *program);
+
+const ShaderBlock *shader_find_block(const ShaderProgram *program, const char *name);
+UniformHandle shader_uniform(const ShaderProgram *program, const char *name, GLenum type);
+int shader_check_attrib(const ShaderProgram *program, const char *name, int location, GLenum type);
+int shader_check_block(const ShaderProgram *program, const char *name, int size);
+
+void shader_set_int(UniformHandle uniform, int value);
+void shader_set_float(UniformHandle uniform, float value);
+void shader_set_vec4(UniformHandle uniform, vec4 value);
+void shader_set_mat4(UniformHandle uniform, mat4 value);
+
+#endif
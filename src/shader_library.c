@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "shader_library.h"
+
+#define EMPTY_SLOT -2
+
+ShaderLibrary shader_library_create(ShaderManager *shaders) {
+	ShaderLibrary library = {0};
+	library.shaders = shaders;
+	return library;
+}
+
+// Register a shader. `features` must outlive the library. Returns its index.
+int shader_library_add(ShaderLibrary *library, const char *vertex_path, const char *fragment_path, const char **features, int feature_count) {
+	if (library->source_count == library->source_capacity) {
+		library->source_capacity = library->source_capacity ? library->source_capacity * 2 : 16;
+		library->sources = realloc(library->sources, library->source_capacity * sizeof(ShaderSource));
+	}
+
+	ShaderSource *source = &library->sources[library->source_count];
+	memset(source, 0, sizeof(*source));
+	snprintf(source->vertex_path, SHADER_PATH_LENGTH, "%s", vertex_path);
+	snprintf(source->fragment_path, SHADER_PATH_LENGTH, "%s", fragment_path);
+	source->feature_count = feature_count < SHADER_MAX_FEATURES ? feature_count : SHADER_MAX_FEATURES;
+	memcpy(source->features, features, source->feature_count * sizeof(const char *));
+	return library->source_count++;
+}
+
+// 64 bit finalizer from MurmurHash3.
+static uint64_t hash_key(uint64_t key) {
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdull;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ull;
+	key ^= key >> 33;
+	return key;
+}
+
+static ShaderVariant *find_slot(ShaderVariant *variants, int capacity, uint64_t key) {
+	int mask = capacity - 1;
+	int slot = (int)(hash_key(key) & mask);
+	while (variants[slot].handle != EMPTY_SLOT && variants[slot].key != key) {
+		slot = (slot + 1) & mask;
+	}
+	return &variants[slot];
+}
+
+// Keep the load factor at or below one half.
+static void grow(ShaderLibrary *library) {
+	int capacity = library->variant_capacity > 0 ? library->variant_capacity * 2 : 64;
+	ShaderVariant *variants = malloc(capacity * sizeof(ShaderVariant));
+	for (int i = 0; i < capacity; i++) {
+		variants[i].handle = EMPTY_SLOT;
+	}
+	for (int i = 0; i < library->variant_capacity; i++) {
+		if (library->variants[i].handle != EMPTY_SLOT) {
+			*find_slot(variants, capacity, library->variants[i].key) = library->variants[i];
+		}
+	}
+	free(library->variants);
+	library->variants = variants;
+	library->variant_capacity = capacity;
+}
+
+// Submit a permutation to the shader manager.
+static int build_variant(ShaderLibrary *library, const ShaderSource *source, uint32_t permutation) {
+	char defines[1024] = "";
+	size_t length = 0;
+	for (int i = 0; i < source->feature_count; i++) {
+		if (permutation & (1u << i)) {
+			length += snprintf(defines + length, sizeof(defines) - length, "#define %s\n", source->features[i]);
+			if (length >= sizeof(defines)) {
+				printf("Defines of %s too long\n", source->fragment_path);
+				return -1;
+			}
+		}
+	}
+	return shader_manager_add_files(library->shaders, source->vertex_path, source->fragment_path, defines);
+}
+
+// ShaderManager handle of a permutation, submitted for compilation the first
+// time it is asked for. -1 if its sources are missing.
+int shader_library_variant(ShaderLibrary *library, int shader, uint32_t permutation) {
+	uint64_t key = (uint64_t)shader << 32 | permutation;
+	if (library->variant_capacity > 0) {
+		ShaderVariant *variant = find_slot(library->variants, library->variant_capacity, key);
+		if (variant->handle != EMPTY_SLOT) {
+			return variant->handle;
+		}
+	}
+
+	if ((library->variant_count + 1) * 2 > library->variant_capacity) {
+		grow(library);
+	}
+	ShaderVariant *variant = find_slot(library->variants, library->variant_capacity, key);
+	variant->key = key;
+	variant->handle = build_variant(library, &library->sources[shader], permutation);
+	library->variant_count++;
+	return variant->handle;
+}
+
+// Program to draw a permutation with. The placeholder until it is ready.
+const ShaderProgram *shader_library_program(ShaderLibrary *library, int shader, uint32_t permutation) {
+	return shader_manager_program(library->shaders, shader_library_variant(library, shader, permutation));
+}
+
+// The programs themselves belong to the shader manager.
+void shader_library_destroy(ShaderLibrary *library) {
+	free(library->sources);
+	free(library->variants);
+	memset(library, 0, sizeof(*library));
+}
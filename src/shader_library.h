@@ -0,0 +1,41 @@
+#ifndef SHADER_LIBRARY_H
+#define SHADER_LIBRARY_H
+
+#include <stdint.h>
+#include "shader_manager.h"
+
+#define SHADER_MAX_FEATURES 32
+
+// Shader compiled in permutations. Bit i of a permutation adds
+// "#define features[i]", e.g. "FOG" or "LIGHT_COUNT 4".
+typedef struct {
+	char vertex_path[SHADER_PATH_LENGTH];
+	char fragment_path[SHADER_PATH_LENGTH];
+	const char *features[SHADER_MAX_FEATURES];
+	int feature_count;
+} ShaderSource;
+
+typedef struct {
+	uint64_t key; // Shader index in the high half, permutation in the low half.
+	int handle;   // ShaderManager handle, -2 for an empty slot.
+} ShaderVariant;
+
+// Specialized variants of each shader, compiled on first use, so the hot path
+// picks a program instead of branching on uniforms inside the shader.
+typedef struct {
+	ShaderManager *shaders;
+	ShaderSource *sources;
+	int source_count;
+	int source_capacity;
+	ShaderVariant *variants; // Open addressing hash map, power of two capacity.
+	int variant_count;
+	int variant_capacity;
+} ShaderLibrary;
+
+ShaderLibrary shader_library_create(ShaderManager *shaders);
+int shader_library_add(ShaderLibrary *library, const char *vertex_path, const char *fragment_path, const char **features, int feature_count);
+int shader_library_variant(ShaderLibrary *library, int shader, uint32_t permutation);
+const ShaderProgram *shader_library_program(ShaderLibrary *library, int shader, uint32_t permutation);
+void shader_library_destroy(ShaderLibrary *library);
+
+#endif
@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "shader_manager.h"
+
+// The placeholder is built right away, it should be trivial to compile.
+ShaderManager shader_manager_create(const char *vertex_source, const char *fragment_source, ShaderReadyFn ready, void *ctx) {
+	ShaderManager shaders = {0};
+	shaders.ready = ready;
+	shaders.ctx = ctx;
+	shaders.placeholder = shader_program_create(vertex_source, fragment_source, NULL);
+	if (shaders.placeholder.linked && ready && !ready(ctx, &shaders.placeholder)) {
+		shaders.placeholder.linked = 0;
+	}
+	return shaders;
+}
+
+// Submit a program. Returns the handle to look it up with.
+int shader_manager_add(ShaderManager *shaders, const char *vertex_source, const char *fragment_source, const char *defines) {
+	if (shaders->count == shaders->capacity) {
+		shaders->capacity = shaders->capacity ? shaders->capacity * 2 : 16;
+		shaders->entries = realloc(shaders->entries, shaders->capacity * sizeof(ShaderEntry));
+	}
+
+	ShaderEntry *entry = &shaders->entries[shaders->count];
+	memset(entry, 0, sizeof(*entry));
+	entry->build = shader_build_begin(vertex_source, fragment_source, defines);
+	entry->state = SHADER_PENDING;
+	return shaders->count++;
+}
+
+// Load both sources of a file backed entry and note the files they include.
+static int load_sources(ShaderEntry *entry, char **vertex_source, char **fragment_source) {
+	free(entry->includes);
+	entry->includes = NULL;
+	*vertex_source = shader_source_load(entry->vertex_path, &entry->includes);
+	*fragment_source = shader_source_load(entry->fragment_path, &entry->includes);
+	return *vertex_source && *fragment_source;
+}
+
+// Submit a program from source files. Returns its handle, or -1 if a file is missing.
+int shader_manager_add_files(ShaderManager *shaders, const char *vertex_path, const char *fragment_path, const char *defines) {
+	ShaderEntry files = {0};
+	char *vertex_source, *fragment_source;
+	snprintf(files.vertex_path, SHADER_PATH_LENGTH, "%s", vertex_path);
+	snprintf(files.fragment_path, SHADER_PATH_LENGTH, "%s", fragment_path);
+	int handle = -1;
+	if (load_sources(&files, &vertex_source, &fragment_source)) {
+		handle = shader_manager_add(shaders, vertex_source, fragment_source, defines);
+		ShaderEntry *entry = &shaders->entries[handle];
+		memcpy(entry->vertex_path, files.vertex_path, SHADER_PATH_LENGTH);
+		memcpy(entry->fragment_path, files.fragment_path, SHADER_PATH_LENGTH);
+		entry->includes = files.includes;
+		files.includes = NULL;
+		if (defines) {
+			entry->defines = malloc(strlen(defines) + 1);
+			strcpy(entry->defines, defines);
+		}
+	}
+	free(files.includes);
+	free(vertex_source);
+	free(fragment_source);
+	return handle;
+}
+
+static int same_file(const char *path, const char *name) {
+	const char *slash = strrchr(path, '/');
+	return path[0] && strcmp(slash ? slash + 1 : path, name) == 0;
+}
+
+static int includes_file(const char *includes, const char *name) {
+	size_t length = strlen(name);
+	for (const char *line = includes; line && *line; line = strchr(line, '\n')) {
+		line += *line == '\n';
+		if (strncmp(line, name, length) == 0 && line[length] == '\n') {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// Rebuild every program using the file `name` (no directory), directly or
+// through an #include. The current program stays in use until the new one has
+// linked. Returns the number of programs being rebuilt.
+int shader_manager_reload(ShaderManager *shaders, const char *name) {
+	int count = 0;
+	for (int i = 0; i < shaders->count; i++) {
+		ShaderEntry *entry = &shaders->entries[i];
+		if (!same_file(entry->vertex_path, name) && !same_file(entry->fragment_path, name) && !includes_file(entry->includes, name)) {
+			continue;
+		}
+		char *vertex_source, *fragment_source;
+		if (load_sources(entry, &vertex_source, &fragment_source)) {
+			// Builds superseded by this edit are dropped, not waited for.
+			if (entry->state == SHADER_PENDING) {
+				shader_build_discard(&entry->build);
+				entry->build = shader_build_begin(vertex_source, fragment_source, entry->defines);
+			} else {
+				if (entry->reloading) {
+					shader_build_discard(&entry->reload);
+				}
+				entry->reload = shader_build_begin(vertex_source, fragment_source, entry->defines);
+				entry->reloading = 1;
+			}
+			count++;
+		}
+		free(vertex_source);
+		free(fragment_source);
+	}
+	return count;
+}
+
+static void finish(ShaderManager *shaders, ShaderEntry *entry) {
+	entry->program = shader_build_finish(&entry->build);
+	entry->state = SHADER_READY;
+	if (!entry->program.linked || (shaders->ready && !shaders->ready(shaders->ctx, &entry->program))) {
+		printf("Program %u failed, drawing with the placeholder\n", entry->program.id);
+		entry->state = SHADER_FAILED;
+	}
+}
+
+// Swap in a rebuilt program if it linked and passes the ready check. A failed
+// rebuild leaves the old program running.
+static void finish_reload(ShaderManager *shaders, ShaderEntry *entry) {
+	ShaderProgram program = shader_build_finish(&entry->reload);
+	entry->reloading = 0;
+	if (!program.linked || (shaders->ready && !shaders->ready(shaders->ctx, &program))) {
+		printf("Reloading %s and %s failed, keeping the old program\n", entry->vertex_path, entry->fragment_path);
+		shader_program_destroy(&program);
+		return;
+	}
+	shader_program_destroy(&entry->program);
+	entry->program = program;
+	entry->state = SHADER_READY;
+	printf("Reloaded %s and %s\n", entry->vertex_path, entry->fragment_path);
+}
+
+// Collect finished programs, once per frame. Without KHR_parallel_shader_compile
+// completion cannot be queried, so at most one program is collected per call to
+// spread the waits over several frames.
+void shader_manager_poll(ShaderManager *shaders) {
+	for (int i = 0; i < shaders->count; i++) {
+		ShaderEntry *entry = &shaders->entries[i];
+		ShaderBuild *build = entry->state == SHADER_PENDING ? &entry->build : entry->reloading ? &entry->reload : NULL;
+		if (!build || !shader_build_ready(build)) {
+			continue;
+		}
+		int blocking = build->vertex_shader != 0 && !shader_parallel_compile();
+		if (entry->state == SHADER_PENDING) {
+			finish(shaders, entry);
+		} else {
+			finish_reload(shaders, entry);
+		}
+		if (blocking) {
+			break;
+		}
+	}
+}
+
+// Block until the program is finished, for code that cannot use the placeholder.
+void shader_manager_wait(ShaderManager *shaders, int handle) {
+	if (handle >= 0 && shaders->entries[handle].state == SHADER_PENDING) {
+		finish(shaders, &shaders->entries[handle]);
+	}
+}
+
+int shader_manager_ready(const ShaderManager *shaders, int handle) {
+	return handle >= 0 && shaders->entries[handle].state == SHADER_READY;
+}
+
+// Program to draw with: the real one once it has linked, the placeholder before
+// that or for handle -1. Valid until the next shader_manager_add().
+const ShaderProgram *shader_manager_program(const ShaderManager *shaders, int handle) {
+	if (handle < 0 || shaders->entries[handle].state != SHADER_READY) {
+		return &shaders->placeholder;
+	}
+	return &shaders->entries[handle].program;
+}
+
+void shader_manager_destroy(ShaderManager *shaders) {
+	for (int i = 0; i < shaders->count; i++) {
+		ShaderEntry *entry = &shaders->entries[i];
+		if (entry->state == SHADER_PENDING) {
+			shader_build_discard(&entry->build);
+		}
+		if (entry->reloading) {
+			shader_build_discard(&entry->reload);
+		}
+		shader_program_destroy(&entry->program);
+		free(entry->defines);
+		free(entry->includes);
+	}
+	shader_program_destroy(&shaders->placeholder);
+	free(shaders->entries);
+	memset(shaders, 0, sizeof(*shaders));
+}
@@ -0,0 +1,51 @@
+#ifndef SHADER_MANAGER_H
+#define SHADER_MANAGER_H
+
+#include "shader.h"
+
+typedef enum {
+	SHADER_PENDING,
+	SHADER_READY,
+	SHADER_FAILED, // Draws keep using the placeholder.
+} ShaderState;
+
+// Checks a freshly linked program before it is used, e.g. binds its uniform
+// blocks. Returns 0 to reject it.
+typedef int (*ShaderReadyFn)(void *ctx, ShaderProgram *program);
+
+typedef struct {
+	ShaderBuild build;
+	ShaderProgram program;
+	ShaderState state;
+
+	// Sources of programs added from files, for hot reload.
+	char vertex_path[SHADER_PATH_LENGTH];
+	char fragment_path[SHADER_PATH_LENGTH];
+	char *includes; // Included file names, one per line, or NULL.
+	char *defines;
+	ShaderBuild reload; // Replaces `program` once it links.
+	int reloading;
+} ShaderEntry;
+
+// Programs whose compiles and links are all submitted up front and collected
+// later, so loading never waits on the compiler inside the frame loop.
+typedef struct {
+	ShaderEntry *entries;
+	int count;
+	int capacity;
+	ShaderProgram placeholder; // Stands in for programs that are not ready.
+	ShaderReadyFn ready;
+	void *ctx;
+} ShaderManager;
+
+ShaderManager shader_manager_create(const char *vertex_source, const char *fragment_source, ShaderReadyFn ready, void *ctx);
+int shader_manager_add(ShaderManager *shaders, const char *vertex_source, const char *fragment_source, const char *defines);
+int shader_manager_add_files(ShaderManager *shaders, const char *vertex_path, const char *fragment_path, const char *defines);
+int shader_manager_reload(ShaderManager *shaders, const char *name);
+void shader_manager_poll(ShaderManager *shaders);
+void shader_manager_wait(ShaderManager *shaders, int handle);
+int shader_manager_ready(const ShaderManager *shaders, int handle);
+const ShaderProgram *shader_manager_program(const ShaderManager *shaders, int handle);
+void shader_manager_destroy(ShaderManager *shaders);
+
+#endif
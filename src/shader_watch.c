@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "shader_watch.h"
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+static void push(ShaderWatch *watch, const char *name) {
+	SDL_LockMutex(watch->mutex);
+	int queued = 0;
+	for (int i = 0; i < watch->queued && !queued; i++) {
+		queued = strcmp(watch->queue[i], name) == 0;
+	}
+	if (!queued && watch->queued < SHADER_WATCH_QUEUE) {
+		snprintf(watch->queue[watch->queued++], SHADER_WATCH_NAME_LENGTH, "%s", name);
+	}
+	SDL_UnlockMutex(watch->mutex);
+}
+
+// Compare every file's modification time with the last scan. The first scan
+// only records them.
+static void scan(ShaderWatch *watch, int report) {
+	DIR *dir = opendir(watch->directory);
+	if (!dir) {
+		return;
+	}
+	struct dirent *file;
+	while ((file = readdir(dir))) {
+		char path[512];
+		struct stat info;
+		snprintf(path, sizeof(path), "%s/%s", watch->directory, file->d_name);
+		size_t length = strlen(file->d_name);
+		if (file->d_name[0] == '.' || length >= SHADER_WATCH_NAME_LENGTH || stat(path, &info) != 0 || !S_ISREG(info.st_mode)) {
+			continue;
+		}
+
+		int i = 0;
+		while (i < watch->file_count && strcmp(watch->names[i], file->d_name) != 0) {
+			i++;
+		}
+		if (i == watch->file_count) {
+			if (watch->file_count == SHADER_WATCH_MAX_FILES) {
+				continue;
+			}
+			memcpy(watch->names[i], file->d_name, length + 1);
+			watch->times[i] = 0;
+			watch->file_count++;
+		}
+		if (watch->times[i] != (long long)info.st_mtime) {
+			if (report && watch->times[i] != 0) {
+				push(watch, file->d_name);
+			}
+			watch->times[i] = (long long)info.st_mtime;
+		}
+	}
+	closedir(dir);
+}
+
+static int watch_thread(void *data) {
+	ShaderWatch *watch = data;
+	while (SDL_AtomicGet(&watch->running)) {
+#ifdef __linux__
+		if (watch->fd >= 0) {
+			// Wake up now and then to notice shutdown.
+			struct pollfd descriptor = {watch->fd, POLLIN, 0};
+			if (poll(&descriptor, 1, SHADER_WATCH_INTERVAL_MS) <= 0) {
+				continue;
+			}
+			char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+			ssize_t length = read(watch->fd, buffer, sizeof(buffer));
+			for (char *p = buffer; length > 0 && p < buffer + length; ) {
+				struct inotify_event *event = (struct inotify_event *)p;
+				if (event->len > 0 && event->name[0] != '.') {
+					push(watch, event->name);
+				}
+				p += sizeof(struct inotify_event) + event->len;
+			}
+			continue;
+		}
+#endif
+		SDL_Delay(SHADER_WATCH_INTERVAL_MS);
+		scan(watch, 1);
+	}
+	return 0;
+}
+
+ShaderWatch *shader_watch_create(const char *directory) {
+	ShaderWatch *watch = calloc(1, sizeof(ShaderWatch));
+	snprintf(watch->directory, sizeof(watch->directory), "%s", directory);
+	watch->mutex = SDL_CreateMutex();
+	watch->fd = -1;
+#ifdef __linux__
+	// Editors either rewrite the file or move a new one over it.
+	watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (watch->fd >= 0 && inotify_add_watch(watch->fd, directory, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+		close(watch->fd);
+		watch->fd = -1;
+	}
+#endif
+	if (watch->fd < 0) {
+		scan(watch, 0);
+	}
+
+	SDL_AtomicSet(&watch->running, 1);
+	watch->thread = SDL_CreateThread(watch_thread, "shader watch", watch);
+	if (!watch->thread) {
+		printf("Could not create shader watch thread, error: %s\n", SDL_GetError());
+	}
+	return watch;
+}
+
+// Pop the name of a changed file. Returns 0 when none are left.
+int shader_watch_next(ShaderWatch *watch, char name[SHADER_WATCH_NAME_LENGTH]) {
+	SDL_LockMutex(watch->mutex);
+	int found = watch->queued > 0;
+	if (found) {
+		memcpy(name, watch->queue[0], SHADER_WATCH_NAME_LENGTH);
+		watch->queued--;
+		memmove(watch->queue[0], watch->queue[1], watch->queued * SHADER_WATCH_NAME_LENGTH);
+	}
+	SDL_UnlockMutex(watch->mutex);
+	return found;
+}
+
+void shader_watch_destroy(ShaderWatch *watch) {
+	SDL_AtomicSet(&watch->running, 0);
+	SDL_WaitThread(watch->thread, NULL);
+#ifdef __linux__
+	if (watch->fd >= 0) {
+		close(watch->fd);
+	}
+#endif
+	SDL_DestroyMutex(watch->mutex);
+	free(watch);
+}
@@ -0,0 +1,35 @@
+#ifndef SHADER_WATCH_H
+#define SHADER_WATCH_H
+
+#include <SDL2/SDL.h>
+
+#define SHADER_WATCH_NAME_LENGTH 64
+#define SHADER_WATCH_QUEUE 32
+#define SHADER_WATCH_MAX_FILES 64
+#define SHADER_WATCH_INTERVAL_MS 250
+
+// Thread watching a directory of shader sources. Names of files written to are
+// queued for the render thread, which rebuilds the programs using them. Uses
+// inotify on Linux and polls modification times elsewhere.
+typedef struct {
+	char directory[256];
+	SDL_Thread *thread;
+	SDL_atomic_t running;
+	int fd; // inotify descriptor, -1 when polling.
+
+	// Changed file names, deduplicated. Guarded by `mutex`.
+	SDL_mutex *mutex;
+	char queue[SHADER_WATCH_QUEUE][SHADER_WATCH_NAME_LENGTH];
+	int queued;
+
+	// Modification times for polling.
+	char names[SHADER_WATCH_MAX_FILES][SHADER_WATCH_NAME_LENGTH];
+	long long times[SHADER_WATCH_MAX_FILES];
+	int file_count;
+} ShaderWatch;
+
+ShaderWatch *shader_watch_create(const char *directory);
+int shader_watch_next(ShaderWatch *watch, char name[SHADER_WATCH_NAME_LENGTH]);
+void shader_watch_destroy(ShaderWatch *watch);
+
+#endif
@@ -0,0 +1,276 @@
+#include <glad/glad.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "shadow.h"
+#include "cull.h"
+
+ShadowCascades shadow_create(float near_z, float far_z) {
+	ShadowCascades shadows = {0};
+	shadows.near_z = near_z;
+	shadows.far_z = far_z;
+	shadow_set_light(&shadows, (vec3){0.4f, 1.0f, 0.3f}, (vec3){0.6f, 0.6f, 0.55f});
+	shadows.queue = render_queue_create(1024);
+
+	// Hardware PCF: linear filtering of GL_LEQUAL compares.
+	glGenTextures(1, &shadows.depth);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, shadows.depth);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, SHADOW_CASCADES, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+	// Depth only, and every layer starts out unshadowed.
+	glGenFramebuffers(1, &shadows.fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, shadows.fbo);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	for (int i = 0; i < SHADOW_CASCADES; i++) {
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadows.depth, 0, i);
+		if (i == 0 && glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			printf("Shadow map framebuffer incomplete\n");
+		}
+		glClear(GL_DEPTH_BUFFER_BIT);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	glGenBuffers(1, &shadows.uniform_buffer);
+	return shadows;
+}
+
+// Bind a program's Shadows block and shadow map sampler. Programs without the
+// sun pass untouched.
+int shadow_bind_program(const ShaderProgram *program) {
+	const ShaderBlock *block = shader_find_block(program, "Shadows");
+	if (!block) {
+		return 1;
+	}
+	if (!shader_check_block(program, "Shadows", sizeof(ShadowUniforms))) {
+		return 0;
+	}
+	glUniformBlockBinding(program->id, block->index, UBO_BINDING_SHADOWS);
+
+	UniformHandle map = shader_uniform(program, "shadow_map", GL_SAMPLER_2D_ARRAY_SHADOW);
+	if (map.location < 0) {
+		return 0;
+	}
+	glUseProgram(program->id);
+	shader_set_int(map, SHADOW_UNIT);
+	return 1;
+}
+
+// `dir` points towards the light. Every cascade is refitted, and re-rendered if
+// that moved it.
+void shadow_set_light(ShadowCascades *shadows, vec3 dir, vec3 color) {
+	glm_vec3_normalize_to(dir, shadows->light_dir);
+	glm_vec3_copy(color, shadows->light_color);
+	memset(shadows->regions, 0, sizeof(shadows->regions)); // In the old light space.
+}
+
+// View depths the cascades start and end at, blending logarithmic and uniform
+// splits (the practical split scheme).
+static void split_depths(const ShadowCascades *shadows, float splits[SHADOW_CASCADES + 1]) {
+	float near_z = shadows->near_z;
+	float far_z = fminf(SHADOW_DISTANCE, shadows->far_z);
+	for (int i = 0; i <= SHADOW_CASCADES; i++) {
+		float t = (float)i / SHADOW_CASCADES;
+		float log_split = near_z * powf(far_z / near_z, t);
+		float uniform_split = near_z + (far_z - near_z) * t;
+		splits[i] = SHADOW_SPLIT_LAMBDA * log_split + (1.0f - SHADOW_SPLIT_LAMBDA) * uniform_split;
+	}
+}
+
+// Orthographic projection of the slice between view depths `near` and `far`.
+// It is sized to the slice's bounding sphere plus SHADOW_CACHE_MARGIN, which
+// doesn't change as the camera turns. `region` is kept while the sphere stays
+// inside it, so the matrix and the rendered layer stay valid as the camera
+// moves a little. Otherwise it is re-centered in whole texels, so the same world
+// position always lands on the same texel and edges don't shimmer. It reaches
+// back to the scene bounds towards the light to catch every caster. Returns the
+// world size of a texel.
+static float fit_cascade(const ShadowCascades *shadows, ShadowRegion *region, vec4 frustum[8], float near, float far, mat4 light_view, vec3 scene_box[2], mat4 dest) {
+	vec4 corners[8];
+	glm_frustum_corners_at(frustum, near, shadows->far_z, corners);
+	glm_frustum_corners_at(frustum, far, shadows->far_z, corners + 4);
+	vec4 center;
+	glm_frustum_center(corners, center);
+	float radius = 0.0f;
+	for (int i = 0; i < 8; i++) {
+		radius = fmaxf(radius, glm_vec3_distance(corners[i], center));
+	}
+	radius = ceilf(radius * 16.0f) / 16.0f; // Rounding noise must not resize the cascade.
+	float size = 2.0f * radius * (1.0f + SHADOW_CACHE_MARGIN);
+	float texel = size / SHADOW_MAP_SIZE;
+
+	// The light looks down -z.
+	vec4 origin;
+	glm_mat4_mulv(light_view, center, origin);
+	vec3 box[2];
+	glm_frustum_box(corners, light_view, box);
+	float front = fmaxf(box[1][2], scene_box[1][2]);
+	int inside = region->size == size &&
+		origin[0] - radius >= region->left && origin[0] + radius <= region->left + size &&
+		origin[1] - radius >= region->bottom && origin[1] + radius <= region->bottom + size &&
+		-front >= region->near_plane && -box[0][2] <= region->far_plane;
+	if (!inside) {
+		region->size = size;
+		region->left = floorf((origin[0] - 0.5f * size) / texel) * texel;
+		region->bottom = floorf((origin[1] - 0.5f * size) / texel) * texel;
+		// Depth bounds snap in coarser steps, they only have to contain the casters.
+		float step = texel * 64.0f;
+		region->near_plane = floorf(-front / step) * step - step;
+		region->far_plane = ceilf(-box[0][2] / step) * step + step;
+	}
+
+	mat4 proj;
+	glm_ortho(region->left, region->left + size, region->bottom, region->bottom + size, region->near_plane, region->far_plane, proj);
+	glm_mat4_mul(proj, light_view, dest);
+	return texel;
+}
+
+// Coarsest level of detail that stays within a shadow map texel of `texel` world
+// size. Depends only on the object and the cascade, so cached layers stay valid.
+static int caster_lod(const Mesh *mesh, mat4 model, float texel) {
+	float scale = fmaxf(glm_vec3_norm(model[0]), fmaxf(glm_vec3_norm(model[1]), glm_vec3_norm(model[2])));
+	int lod = 0;
+	while (lod + 1 < mesh->lod_count && mesh->lods[lod + 1].error * scale <= texel) {
+		lod++;
+	}
+	return lod;
+}
+
+// Draw every object inside `light_view_proj` into layer `cascade`. Returns 0 if
+// the Draw ring is out of space, leaving the layer stale.
+static int render_cascade(ShadowCascades *shadows, const Scene *scene, int cascade, mat4 light_view_proj, float texel, const ShaderProgram *program, UboSystem *ubo) {
+	vec4 planes[6];
+	glm_frustum_planes(light_view_proj, planes);
+	int count = cull_frustum_aabbs(&scene->bounds, planes, shadows->casters);
+
+	for (int i = 0; i < count; i++) {
+		glm_mat4_copy(scene->models[shadows->casters[i]], shadows->draws[i].model);
+	}
+	size_t base = count > 0 ? ubo_push_draws(ubo, shadows->draws, count) : 0;
+	if (base == (size_t)-1) {
+		return 0;
+	}
+	render_queue_clear(&shadows->queue);
+	for (int i = 0; i < count; i++) {
+		DrawPacket *packet = render_queue_push(&shadows->queue, render_key(RENDER_LAYER_OPAQUE, program->id, 0, scene->mesh->vao, 0));
+		packet->program = program->id;
+		packet->vao = scene->mesh->vao;
+		packet->draw_offset = (unsigned int)ubo_draw_offset(ubo, base, i);
+		const MeshLod *lod = &scene->mesh->lods[caster_lod(scene->mesh, scene->models[shadows->casters[i]], texel)];
+		packet->first_index = lod->first_index;
+		packet->index_count = lod->index_count;
+		packet->instance_count = 1; // Identity instance, as in the scene pass.
+	}
+
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadows->depth, 0, cascade);
+	glClear(GL_DEPTH_BUFFER_BIT);
+	glUseProgram(program->id);
+	shader_set_mat4(shader_uniform(program, "light_view_proj", GL_FLOAT_MAT4), light_view_proj);
+	render_queue_submit(&shadows->queue, ubo, RENDER_PASS_DEPTH);
+	return 1;
+}
+
+// Fit the cascades to the camera in `frame`, re-render the ones whose projection,
+// light or contents changed with `caster_program`, and bind the result for the
+// lighting pass. Until the caster program is ready (NULL) nothing is shadowed.
+// Restores the `output` framebuffer and a `width` by `height` viewport.
+void shadow_update(ShadowCascades *shadows, const Scene *scene, const FrameUniforms *frame, const ShaderProgram *caster_program, UboSystem *ubo, unsigned int output, int width, int height) {
+	if (shadows->capacity < scene->count) {
+		shadows->capacity = scene->count;
+		shadows->casters = realloc(shadows->casters, shadows->capacity * sizeof(int));
+		shadows->draws = realloc(shadows->draws, shadows->capacity * sizeof(DrawUniforms));
+		for (int i = 0; i < shadows->capacity; i++) {
+			glm_vec4_copy((vec4){1.0f, 1.0f, 1.0f, 0.0f}, shadows->draws[i].color);
+		}
+	}
+	shadows->updates++;
+
+	// Rotation only, so texel snapping in light space is snapping in world space.
+	mat4 light_view;
+	vec3 light_forward, up = {0.0f, 1.0f, 0.0f};
+	glm_vec3_negate_to(shadows->light_dir, light_forward);
+	if (fabsf(light_forward[1]) > 0.99f) {
+		glm_vec3_copy((vec3){1.0f, 0.0f, 0.0f}, up);
+	}
+	glm_look((vec3){0.0f, 0.0f, 0.0f}, light_forward, up, light_view);
+	vec3 scene_box[2] = {{0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f}};
+	if (scene->bvh.node_count > 0) {
+		glm_aabb_transform((vec3 *)scene->bvh.nodes[0].bounds, light_view, scene_box);
+	}
+
+	vec4 frustum[8];
+	float splits[SHADOW_CASCADES + 1];
+	glm_frustum_corners((vec4 *)frame->inv_view_proj, frustum);
+	split_depths(shadows, splits);
+
+	// From [-1, 1] clip space to texture coordinates and depth.
+	mat4 bias = {
+		{0.5f, 0.0f, 0.0f, 0.0f},
+		{0.0f, 0.5f, 0.0f, 0.0f},
+		{0.0f, 0.0f, 0.5f, 0.0f},
+		{0.5f, 0.5f, 0.5f, 1.0f}
+	};
+	int bound = 0;
+	for (int i = 0; i < SHADOW_CASCADES; i++) {
+		mat4 light_view_proj;
+		shadows->uniforms.splits[i] = splits[i + 1];
+		shadows->uniforms.texel_size[i] = fit_cascade(shadows, &shadows->regions[i], frustum, splits[i], splits[i + 1], light_view, scene_box, light_view_proj);
+		glm_mat4_mul(bias, light_view_proj, shadows->uniforms.cascades[i]);
+
+		int unchanged = (shadows->valid & (1 << i)) &&
+			memcmp(shadows->rendered[i], light_view_proj, sizeof(mat4)) == 0;
+		if (unchanged || !caster_program) {
+			continue;
+		}
+		if (!bound) {
+			glBindFramebuffer(GL_FRAMEBUFFER, shadows->fbo);
+			glViewport(0, 0, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE);
+			glEnable(GL_POLYGON_OFFSET_FILL);
+			glPolygonOffset(2.0f, 2.0f); // Slope scaled, against acne on lit faces.
+			bound = 1;
+		}
+		if (render_cascade(shadows, scene, i, light_view_proj, shadows->uniforms.texel_size[i], caster_program, ubo)) {
+			glm_mat4_copy(light_view_proj, shadows->rendered[i]);
+			shadows->valid |= 1 << i;
+			shadows->renders++;
+		} else {
+			shadows->valid &= ~(1 << i);
+		}
+	}
+	if (bound) {
+		glDisable(GL_POLYGON_OFFSET_FILL);
+		glBindFramebuffer(GL_FRAMEBUFFER, output);
+		glViewport(0, 0, width, height);
+	}
+
+	glm_vec4(shadows->light_dir, 0.0f, shadows->uniforms.light_dir);
+	glm_vec4(shadows->light_color, 0.0f, shadows->uniforms.light_color);
+	glBindBuffer(GL_UNIFORM_BUFFER, shadows->uniform_buffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(ShadowUniforms), &shadows->uniforms, GL_DYNAMIC_DRAW); // Orphan.
+	glBindBufferBase(GL_UNIFORM_BUFFER, UBO_BINDING_SHADOWS, shadows->uniform_buffer);
+	glActiveTexture(GL_TEXTURE0 + SHADOW_UNIT);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, shadows->depth);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+void shadow_report(const ShadowCascades *shadows) {
+	int possible = shadows->updates * SHADOW_CASCADES;
+	printf("Shadow cascades: %d of %d re-rendered, %.1f%% cache hits\n", shadows->renders, possible, possible ? 100.0f * (possible - shadows->renders) / possible : 0.0f);
+}
+
+void shadow_destroy(ShadowCascades *shadows) {
+	glDeleteTextures(1, &shadows->depth);
+	glDeleteFramebuffers(1, &shadows->fbo);
+	glDeleteBuffers(1, &shadows->uniform_buffer);
+	render_queue_destroy(&shadows->queue);
+	free(shadows->casters);
+	free(shadows->draws);
+	memset(shadows, 0, sizeof(*shadows));
+}
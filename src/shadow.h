@@ -0,0 +1,68 @@
+#ifndef SHADOW_H
+#define SHADOW_H
+
+#include <cglm/cglm.h>
+#include "render_queue.h"
+#include "scene.h"
+#include "shader.h"
+#include "ubo.h"
+
+#define SHADOW_CASCADES 4
+#define SHADOW_MAP_SIZE 1024
+#define SHADOW_DISTANCE 8.0f // View depth the last cascade ends at.
+#define SHADOW_SPLIT_LAMBDA 0.75f // 0 splits evenly, 1 logarithmically.
+#define SHADOW_UNIT 7 // Texture unit of the shadow map, past the G-buffer ones.
+#define SHADOW_CACHE_MARGIN 0.25f // Extra cascade size, as a fraction of the slice's, the camera can move in.
+
+// std140 "Shadows" block.
+typedef struct {
+	mat4 cascades[SHADOW_CASCADES]; // World to shadow map texture coordinates and depth.
+	vec4 splits;      // View depth each cascade ends at.
+	vec4 texel_size;  // World size of a texel in each cascade, for normal offsets.
+	vec4 light_dir;   // Towards the sun, w unused.
+	vec4 light_color;
+} ShadowUniforms;
+
+// Light space area a cascade covers, in whole texels.
+typedef struct {
+	float left, bottom;
+	float size; // 0 until fitted.
+	float near_plane, far_plane;
+} ShadowRegion;
+
+// Cascaded shadow maps for one directional light. The view frustum up to
+// SHADOW_DISTANCE is split into SHADOW_CASCADES slices, each covered by an
+// orthographic projection SHADOW_CACHE_MARGIN larger than the slice's bounding
+// sphere. A cascade keeps its region, and its rendered layer, until the slice
+// leaves it or the light changes; it then re-centers in whole texels, so edges
+// don't shimmer. Casters are static: objects never move after scene_create().
+typedef struct {
+	float near_z, far_z; // Camera clip planes.
+	vec3 light_dir;
+	vec3 light_color;
+	unsigned int depth; // GL_TEXTURE_2D_ARRAY, one layer per cascade.
+	unsigned int fbo;
+	unsigned int uniform_buffer;
+	ShadowUniforms uniforms;
+
+	// What each layer covers and was last rendered with.
+	ShadowRegion regions[SHADOW_CASCADES];
+	mat4 rendered[SHADOW_CASCADES];
+	int valid; // Bit per cascade.
+
+	int *casters;
+	DrawUniforms *draws;
+	int capacity;
+	RenderQueue queue;
+	int renders; // Cascades rendered, for the report.
+	int updates;
+} ShadowCascades;
+
+ShadowCascades shadow_create(float near_z, float far_z);
+int shadow_bind_program(const ShaderProgram *program);
+void shadow_set_light(ShadowCascades *shadows, vec3 dir, vec3 color);
+void shadow_update(ShadowCascades *shadows, const Scene *scene, const FrameUniforms *frame, const ShaderProgram *caster_program, UboSystem *ubo, unsigned int output, int width, int height);
+void shadow_report(const ShadowCascades *shadows);
+void shadow_destroy(ShadowCascades *shadows);
+
+#endif
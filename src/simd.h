@@ -0,0 +1,84 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+// Widest float vector the target supports. AVX gives 8 lanes, SSE2 and NEON 4,
+// and anything else falls back to plain floats with SIMD_WIDTH 1. Comparisons
+// return all-ones lanes for true, for v_and, v_select and v_movemask.
+#if defined(__AVX__)
+#include <immintrin.h>
+#define SIMD_WIDTH 8
+typedef __m256 vfloat;
+#define v_load(p) _mm256_loadu_ps(p)
+#define v_store(p, a) _mm256_storeu_ps(p, a)
+#define v_set1(x) _mm256_set1_ps(x)
+#define v_add(a, b) _mm256_add_ps(a, b)
+#define v_sub(a, b) _mm256_sub_ps(a, b)
+#define v_mul(a, b) _mm256_mul_ps(a, b)
+#define v_min(a, b) _mm256_min_ps(a, b)
+#define v_max(a, b) _mm256_max_ps(a, b)
+#define v_and(a, b) _mm256_and_ps(a, b)
+#define v_ge(a, b) _mm256_cmp_ps(a, b, _CMP_GE_OQ)
+#define v_select(mask, a, b) _mm256_blendv_ps(b, a, mask)
+#define v_true() _mm256_castsi256_ps(_mm256_set1_epi32(-1))
+#define v_movemask(a) _mm256_movemask_ps(a)
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SIMD_WIDTH 4
+typedef __m128 vfloat;
+#define v_load(p) _mm_loadu_ps(p)
+#define v_store(p, a) _mm_storeu_ps(p, a)
+#define v_set1(x) _mm_set1_ps(x)
+#define v_add(a, b) _mm_add_ps(a, b)
+#define v_sub(a, b) _mm_sub_ps(a, b)
+#define v_mul(a, b) _mm_mul_ps(a, b)
+#define v_min(a, b) _mm_min_ps(a, b)
+#define v_max(a, b) _mm_max_ps(a, b)
+#define v_and(a, b) _mm_and_ps(a, b)
+#define v_ge(a, b) _mm_cmpge_ps(a, b)
+#define v_select(mask, a, b) _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b))
+#define v_true() _mm_castsi128_ps(_mm_set1_epi32(-1))
+#define v_movemask(a) _mm_movemask_ps(a)
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define SIMD_WIDTH 4
+typedef float32x4_t vfloat;
+#define v_load(p) vld1q_f32(p)
+#define v_store(p, a) vst1q_f32(p, a)
+#define v_set1(x) vdupq_n_f32(x)
+#define v_add(a, b) vaddq_f32(a, b)
+#define v_sub(a, b) vsubq_f32(a, b)
+#define v_mul(a, b) vmulq_f32(a, b)
+#define v_min(a, b) vminq_f32(a, b)
+#define v_max(a, b) vmaxq_f32(a, b)
+#define v_and(a, b) vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b)))
+#define v_ge(a, b) vreinterpretq_f32_u32(vcgeq_f32(a, b))
+#define v_select(mask, a, b) vbslq_f32(vreinterpretq_u32_f32(mask), a, b)
+#define v_true() vreinterpretq_f32_u32(vdupq_n_u32(0xffffffffu))
+static inline int v_movemask(float32x4_t a) {
+	static const int32_t shifts[4] = {0, 1, 2, 3};
+	uint32x4_t signs = vshrq_n_u32(vreinterpretq_u32_f32(a), 31);
+	return (int)vaddvq_u32(vshlq_u32(signs, vld1q_s32(shifts)));
+}
+#else
+#include <stdint.h>
+#include <string.h>
+#define SIMD_WIDTH 1
+typedef float vfloat;
+static inline uint32_t v_bits(float a) { uint32_t u; memcpy(&u, &a, 4); return u; }
+static inline float v_from_bits(uint32_t u) { float a; memcpy(&a, &u, 4); return a; }
+#define v_load(p) (*(p))
+#define v_store(p, a) (*(p) = (a))
+#define v_set1(x) (x)
+#define v_add(a, b) ((a) + (b))
+#define v_sub(a, b) ((a) - (b))
+#define v_mul(a, b) ((a) * (b))
+#define v_min(a, b) ((a) < (b) ? (a) : (b))
+#define v_max(a, b) ((a) > (b) ? (a) : (b))
+#define v_and(a, b) v_from_bits(v_bits(a) & v_bits(b))
+#define v_ge(a, b) v_from_bits((a) >= (b) ? 0xffffffffu : 0u)
+#define v_select(mask, a, b) (v_bits(mask) ? (a) : (b))
+#define v_true() v_from_bits(0xffffffffu)
+#define v_movemask(a) ((int)(v_bits(a) >> 31))
+#endif
+
+#endif
@@ -0,0 +1,290 @@
+#include <cglm/cglm.h>
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "mesh.h"
+
+// Boundary edges get a plane perpendicular to their triangle, weighted this much
+// more than a surface plane so open borders don't shrink.
+#define BOUNDARY_WEIGHT 10.0
+// Collapses may not tilt a triangle's normal further than acos of this.
+#define FLIP_THRESHOLD 0.25f
+
+// Sum of squared distances to a set of planes, as the symmetric 4x4 matrix
+// (a b c d)^T (a b c d), weighted by area. `w` is the total weight.
+typedef struct {
+	double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2, w;
+} Quadric;
+
+typedef struct {
+	unsigned int from, to;
+	float cost;
+} Collapse;
+
+static void quadric_add_plane(Quadric *q, double a, double b, double c, double d, double w) {
+	q->a2 += w * a * a; q->ab += w * a * b; q->ac += w * a * c; q->ad += w * a * d;
+	q->b2 += w * b * b; q->bc += w * b * c; q->bd += w * b * d;
+	q->c2 += w * c * c; q->cd += w * c * d;
+	q->d2 += w * d * d;
+	q->w += w;
+}
+
+static void quadric_add(Quadric *q, const Quadric *other) {
+	q->a2 += other->a2; q->ab += other->ab; q->ac += other->ac; q->ad += other->ad;
+	q->b2 += other->b2; q->bc += other->bc; q->bd += other->bd;
+	q->c2 += other->c2; q->cd += other->cd;
+	q->d2 += other->d2;
+	q->w += other->w;
+}
+
+// Weighted mean squared distance of `v` to the quadric's planes.
+static float quadric_error(const Quadric *q, const float *v) {
+	double x = v[0], y = v[1], z = v[2];
+	double error = q->a2 * x * x + q->b2 * y * y + q->c2 * z * z +
+		2.0 * (q->ab * x * y + q->ac * x * z + q->bc * y * z) +
+		2.0 * (q->ad * x + q->bd * y + q->cd * z) + q->d2;
+	return (float)(fabs(error) / (q->w > 0.0 ? q->w : 1.0));
+}
+
+static int compare_collapses(const void *a, const void *b) {
+	float ca = ((const Collapse *)a)->cost;
+	float cb = ((const Collapse *)b)->cost;
+	return (ca > cb) - (ca < cb);
+}
+
+// Vertex to triangle adjacency in compressed form: the triangles of vertex v are
+// triangles[offsets[v] .. offsets[v + 1]).
+static void build_adjacency(const unsigned int *indices, int index_count, int vertex_count, int *offsets, int *triangles) {
+	memset(offsets, 0, (vertex_count + 1) * sizeof(int));
+	for (int i = 0; i < index_count; i++) {
+		offsets[indices[i] + 1]++;
+	}
+	for (int v = 0; v < vertex_count; v++) {
+		offsets[v + 1] += offsets[v];
+	}
+	int *fill = malloc(vertex_count * sizeof(int));
+	memcpy(fill, offsets, vertex_count * sizeof(int));
+	for (int i = 0; i < index_count; i++) {
+		triangles[fill[indices[i]]++] = i / 3;
+	}
+	free(fill);
+}
+
+typedef struct {
+	float pos[3];
+	unsigned int index;
+} SortVertex;
+
+static int compare_sort_vertices(const void *a, const void *b) {
+	const float *pa = ((const SortVertex *)a)->pos;
+	const float *pb = ((const SortVertex *)b)->pos;
+	for (int k = 0; k < 3; k++) {
+		if (pa[k] != pb[k]) {
+			return pa[k] < pb[k] ? -1 : 1;
+		}
+	}
+	return 0;
+}
+
+// Whether moving `from` onto `to` keeps every triangle around `from` facing the same way.
+static int collapse_keeps_normals(const float *vertices, int stride, const unsigned int *indices, const int *offsets, const int *triangles, unsigned int from, unsigned int to) {
+	for (int i = offsets[from]; i < offsets[from + 1]; i++) {
+		const unsigned int *tri = indices + triangles[i] * 3;
+		if (tri[0] == to || tri[1] == to || tri[2] == to) {
+			continue; // Collapses to nothing.
+		}
+
+		vec3 before[3], after[3];
+		for (int k = 0; k < 3; k++) {
+			glm_vec3_copy((float *)(vertices + tri[k] * stride), before[k]);
+			glm_vec3_copy((float *)(vertices + (tri[k] == from ? to : tri[k]) * stride), after[k]);
+		}
+		vec3 e1, e2, n_before, n_after;
+		glm_vec3_sub(before[1], before[0], e1);
+		glm_vec3_sub(before[2], before[0], e2);
+		glm_vec3_cross(e1, e2, n_before);
+		glm_vec3_sub(after[1], after[0], e1);
+		glm_vec3_sub(after[2], after[0], e2);
+		glm_vec3_cross(e1, e2, n_after);
+		if (glm_vec3_dot(n_before, n_after) <= FLIP_THRESHOLD * glm_vec3_norm(n_before) * glm_vec3_norm(n_after)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// Simplify a triangle list towards `target_index_count` indices with quadric
+// error metric edge collapses. Vertices are only ever moved onto their neighbors,
+// so the result indexes the original vertex buffer. Vertices sharing a position
+// with another (attribute seams) stay put. Writes the new index list to
+// `destination` (index_count entries) and the largest collapse error, as an
+// object space distance, to `error`. Returns the new index count.
+int mesh_simplify(const float *vertices, int stride, int vertex_count, const unsigned int *indices, int index_count, int target_index_count, unsigned int *destination, float *error) {
+	memcpy(destination, indices, index_count * sizeof(unsigned int));
+	float max_cost = 0.0f;
+
+	int *offsets = malloc((vertex_count + 1) * sizeof(int));
+	int *triangles = malloc(index_count * sizeof(int));
+	Quadric *quadrics = calloc(vertex_count, sizeof(Quadric));
+	unsigned int *remap = malloc(vertex_count * sizeof(unsigned int));
+	char *locked = calloc(vertex_count, 1);
+	char *touched = malloc(vertex_count);
+	Collapse *collapses = malloc(index_count * sizeof(Collapse));
+
+	// Lock seam vertices.
+	SortVertex *order = malloc(vertex_count * sizeof(SortVertex));
+	for (int v = 0; v < vertex_count; v++) {
+		memcpy(order[v].pos, vertices + v * stride, sizeof(order[v].pos));
+		order[v].index = v;
+	}
+	qsort(order, vertex_count, sizeof(SortVertex), compare_sort_vertices);
+	for (int v = 1; v < vertex_count; v++) {
+		if (compare_sort_vertices(&order[v - 1], &order[v]) == 0) {
+			locked[order[v - 1].index] = locked[order[v].index] = 1;
+		}
+	}
+	free(order);
+
+	// Every vertex starts with the planes of its triangles, plus border planes.
+	build_adjacency(destination, index_count, vertex_count, offsets, triangles);
+	for (int t = 0; t < index_count / 3; t++) {
+		const unsigned int *tri = destination + t * 3;
+		float *p[3];
+		for (int k = 0; k < 3; k++) {
+			p[k] = (float *)(vertices + tri[k] * stride);
+		}
+		vec3 e1, e2, normal;
+		glm_vec3_sub(p[1], p[0], e1);
+		glm_vec3_sub(p[2], p[0], e2);
+		glm_vec3_cross(e1, e2, normal);
+		float area = glm_vec3_norm(normal) * 0.5f;
+		if (area == 0.0f) {
+			continue;
+		}
+		glm_vec3_normalize(normal);
+		for (int k = 0; k < 3; k++) {
+			quadric_add_plane(&quadrics[tri[k]], normal[0], normal[1], normal[2], -glm_vec3_dot(normal, p[0]), area);
+		}
+
+		for (int k = 0; k < 3; k++) {
+			unsigned int a = tri[k], b = tri[(k + 1) % 3];
+			int shared = 0;
+			for (int i = offsets[a]; i < offsets[a + 1]; i++) {
+				const unsigned int *other = destination + triangles[i] * 3;
+				shared += other[0] == b || other[1] == b || other[2] == b;
+			}
+			if (shared == 1) {
+				vec3 edge, edge_normal;
+				glm_vec3_sub(p[(k + 1) % 3], p[k], edge);
+				glm_vec3_cross(edge, normal, edge_normal);
+				glm_vec3_normalize(edge_normal);
+				double d = -glm_vec3_dot(edge_normal, p[k]);
+				double weight = glm_vec3_norm2(edge) * BOUNDARY_WEIGHT;
+				quadric_add_plane(&quadrics[a], edge_normal[0], edge_normal[1], edge_normal[2], d, weight);
+				quadric_add_plane(&quadrics[b], edge_normal[0], edge_normal[1], edge_normal[2], d, weight);
+			}
+		}
+	}
+
+	// Passes of independent collapses, cheapest first, until the target is met.
+	while (index_count > target_index_count) {
+		build_adjacency(destination, index_count, vertex_count, offsets, triangles);
+
+		int collapse_count = 0;
+		for (int i = 0; i < index_count; i++) {
+			unsigned int a = destination[i];
+			unsigned int b = destination[i - i % 3 + (i + 1) % 3];
+			Quadric q = quadrics[a];
+			quadric_add(&q, &quadrics[b]);
+			float a_to_b = locked[a] ? FLT_MAX : quadric_error(&q, vertices + b * stride);
+			float b_to_a = locked[b] ? FLT_MAX : quadric_error(&q, vertices + a * stride);
+			if (a_to_b == FLT_MAX && b_to_a == FLT_MAX) {
+				continue;
+			}
+			Collapse *collapse = &collapses[collapse_count++];
+			collapse->from = a_to_b <= b_to_a ? a : b;
+			collapse->to = a_to_b <= b_to_a ? b : a;
+			collapse->cost = glm_min(a_to_b, b_to_a);
+		}
+		qsort(collapses, collapse_count, sizeof(Collapse), compare_collapses);
+
+		// Each collapse removes about two triangles.
+		int budget = (index_count - target_index_count) / 6 + 1;
+		int collapsed = 0;
+		for (int v = 0; v < vertex_count; v++) {
+			remap[v] = v;
+		}
+		memset(touched, 0, vertex_count);
+		for (int c = 0; c < collapse_count && collapsed < budget; c++) {
+			const Collapse *collapse = &collapses[c];
+			if (touched[collapse->from] || touched[collapse->to] ||
+				!collapse_keeps_normals(vertices, stride, destination, offsets, triangles, collapse->from, collapse->to)) {
+				continue;
+			}
+
+			// Freeze the whole neighborhood so this pass' normal checks stay valid.
+			for (int i = offsets[collapse->from]; i < offsets[collapse->from + 1]; i++) {
+				const unsigned int *tri = destination + triangles[i] * 3;
+				touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = 1;
+			}
+			remap[collapse->from] = collapse->to;
+			quadric_add(&quadrics[collapse->to], &quadrics[collapse->from]);
+			max_cost = glm_max(max_cost, collapse->cost);
+			collapsed++;
+		}
+		if (collapsed == 0) {
+			break;
+		}
+
+		// Apply the pass and drop triangles that collapsed.
+		int written = 0;
+		for (int i = 0; i < index_count; i += 3) {
+			unsigned int a = remap[destination[i]], b = remap[destination[i + 1]], p = remap[destination[i + 2]];
+			if (a != b && b != p && p != a) {
+				destination[written++] = a;
+				destination[written++] = b;
+				destination[written++] = p;
+			}
+		}
+		index_count = written;
+	}
+
+	// Cleanup.
+	free(offsets);
+	free(triangles);
+	free(quadrics);
+	free(remap);
+	free(locked);
+	free(touched);
+	free(collapses);
+
+	*error = sqrtf(max_cost);
+	return index_count;
+}
+
+// Append a chain of simplified index lists to `data`, each about half the
+// triangles of the one before, until MESH_MAX_LODS or no further progress.
+void mesh_data_build_lods(MeshData *data) {
+	while (data->lod_count < MESH_MAX_LODS) {
+		const MeshLod *previous = &data->lods[data->lod_count - 1];
+		unsigned int *lod_indices = malloc(previous->index_count * sizeof(unsigned int));
+		float error;
+		int index_count = mesh_simplify(data->vertices, data->stride, data->vertex_count,
+			data->indices + previous->first_index, previous->index_count, previous->index_count / 6 * 3, lod_indices, &error);
+		if (index_count == 0 || index_count > previous->index_count * 9 / 10) {
+			free(lod_indices);
+			break;
+		}
+		mesh_optimize_vertex_cache(lod_indices, index_count, data->vertex_count);
+
+		MeshLod *lod = &data->lods[data->lod_count++];
+		lod->first_index = data->index_count;
+		lod->index_count = index_count;
+		lod->error = previous->error + error; // Each level is simplified from the one before.
+		data->indices = realloc(data->indices, (data->index_count + index_count) * sizeof(unsigned int));
+		memcpy(data->indices + data->index_count, lod_indices, index_count * sizeof(unsigned int));
+		data->index_count += index_count;
+		free(lod_indices);
+	}
+}
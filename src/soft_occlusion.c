@@ -0,0 +1,352 @@
+#include <SDL2/SDL.h>
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "soft_occlusion.h"
+#include "simd.h"
+
+#define SOFT_TILE_PIXELS (SOFT_TILE_SIZE * SOFT_TILE_SIZE)
+#define SOFT_TEST_BATCH 256 // Boxes per test job.
+
+// Pixel offsets within one vector. SOFT_TILE_SIZE is a multiple of SIMD_WIDTH.
+static const float lane_offsets[8] = {0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f};
+
+SoftOcclusion soft_occlusion_create(int width, int height, JobSystem *jobs) {
+	SoftOcclusion occlusion = {0};
+	occlusion.tiles_x = (width + SOFT_TILE_SIZE - 1) / SOFT_TILE_SIZE;
+	occlusion.tiles_y = (height + SOFT_TILE_SIZE - 1) / SOFT_TILE_SIZE;
+	occlusion.width = occlusion.tiles_x * SOFT_TILE_SIZE;
+	occlusion.height = occlusion.tiles_y * SOFT_TILE_SIZE;
+	occlusion.depth = malloc(occlusion.width * occlusion.height * sizeof(float));
+	occlusion.tile_max = malloc(occlusion.tiles_x * occlusion.tiles_y * sizeof(float));
+	occlusion.jobs = jobs;
+	glm_mat4_identity(occlusion.view_proj);
+	return occlusion;
+}
+
+// Start a new frame of occluders seen through `view_proj`.
+void soft_occlusion_begin(SoftOcclusion *occlusion, mat4 view_proj) {
+	glm_mat4_copy(view_proj, occlusion->view_proj);
+	occlusion->triangle_count = 0;
+}
+
+// Project a clip space triangle in front of the near plane to the screen.
+static void push_triangle(SoftOcclusion *occlusion, vec4 clip[3]) {
+	SoftTriangle triangle;
+	float min_x = FLT_MAX, max_x = -FLT_MAX, min_y = FLT_MAX, max_y = -FLT_MAX;
+	for (int k = 0; k < 3; k++) {
+		float inv_w = 1.0f / clip[k][3];
+		triangle.x[k] = (clip[k][0] * inv_w * 0.5f + 0.5f) * occlusion->width;
+		triangle.y[k] = (clip[k][1] * inv_w * 0.5f + 0.5f) * occlusion->height;
+		triangle.z[k] = clip[k][2] * inv_w * 0.5f + 0.5f;
+		min_x = glm_min(min_x, triangle.x[k]);
+		max_x = glm_max(max_x, triangle.x[k]);
+		min_y = glm_min(min_y, triangle.y[k]);
+		max_y = glm_max(max_y, triangle.y[k]);
+	}
+
+	float area = (triangle.x[1] - triangle.x[0]) * (triangle.y[2] - triangle.y[0]) - (triangle.x[2] - triangle.x[0]) * (triangle.y[1] - triangle.y[0]);
+	if (fabsf(area) < 1e-6f || max_x < 0.0f || min_x > occlusion->width || max_y < 0.0f || min_y > occlusion->height) {
+		return; // Degenerate or off screen.
+	}
+	triangle.min_y = glm_max((int)floorf(min_y), 0);
+	triangle.max_y = glm_min((int)ceilf(max_y), occlusion->height - 1);
+
+	if (occlusion->triangle_count == occlusion->triangle_capacity) {
+		occlusion->triangle_capacity = occlusion->triangle_capacity ? occlusion->triangle_capacity * 2 : 256;
+		occlusion->triangles = realloc(occlusion->triangles, occlusion->triangle_capacity * sizeof(SoftTriangle));
+	}
+	occlusion->triangles[occlusion->triangle_count++] = triangle;
+}
+
+// Transform an occluder's triangles and queue them for rasterization. `indices`
+// may be NULL for an unindexed triangle list. Triangles crossing the near plane
+// are clipped against it.
+void soft_occlusion_add_occluder(SoftOcclusion *occlusion, const float *vertices, const unsigned int *indices, int index_count, int stride, mat4 model) {
+	mat4 mvp;
+	glm_mat4_mul(occlusion->view_proj, model, mvp);
+
+	for (int t = 0; t + 2 < index_count; t += 3) {
+		vec4 clip[3];
+		float near_dist[3];
+		int inside = 0;
+		for (int k = 0; k < 3; k++) {
+			const float *pos = vertices + (indices ? indices[t + k] : (unsigned int)(t + k)) * stride;
+			glm_mat4_mulv(mvp, (vec4){pos[0], pos[1], pos[2], 1.0f}, clip[k]);
+			near_dist[k] = clip[k][2] + clip[k][3]; // z_ndc >= -1.
+			inside += near_dist[k] >= 0.0f;
+		}
+
+		if (inside == 3) {
+			push_triangle(occlusion, clip);
+		} else if (inside > 0) {
+			// One clipped corner leaves a quad, two leave a smaller triangle.
+			vec4 polygon[4];
+			int n = 0;
+			for (int k = 0; k < 3; k++) {
+				int next = (k + 1) % 3;
+				if (near_dist[k] >= 0.0f) {
+					glm_vec4_copy(clip[k], polygon[n++]);
+				}
+				if ((near_dist[k] >= 0.0f) != (near_dist[next] >= 0.0f)) {
+					glm_vec4_lerp(clip[k], clip[next], near_dist[k] / (near_dist[k] - near_dist[next]), polygon[n++]);
+				}
+			}
+			push_triangle(occlusion, polygon);
+			if (n == 4) {
+				vec4 second[3];
+				glm_vec4_copy(polygon[0], second[0]);
+				glm_vec4_copy(polygon[2], second[1]);
+				glm_vec4_copy(polygon[3], second[2]);
+				push_triangle(occlusion, second);
+			}
+		}
+	}
+}
+
+// JobFn: clear one row of tiles and rasterize every triangle touching it. Rows
+// never share pixels, so no locking is needed.
+static void rasterize_band(void *ctx, int tile_row) {
+	SoftOcclusion *occlusion = ctx;
+	float *band = occlusion->depth + tile_row * occlusion->tiles_x * SOFT_TILE_PIXELS;
+	int band_y0 = tile_row * SOFT_TILE_SIZE;
+	int band_y1 = band_y0 + SOFT_TILE_SIZE - 1;
+	for (int i = 0; i < occlusion->tiles_x * SOFT_TILE_PIXELS; i++) {
+		band[i] = 1.0f;
+	}
+
+	vfloat lanes = v_load(lane_offsets);
+	vfloat zero = v_set1(0.0f);
+	for (int t = 0; t < occlusion->triangle_count; t++) {
+		const SoftTriangle *tri = &occlusion->triangles[t];
+		if (tri->max_y < band_y0 || tri->min_y > band_y1) {
+			continue;
+		}
+
+		// Edge functions a * x + b * y + c, positive inside whatever the winding.
+		float area = (tri->x[1] - tri->x[0]) * (tri->y[2] - tri->y[0]) - (tri->x[2] - tri->x[0]) * (tri->y[1] - tri->y[0]);
+		float sign = area > 0.0f ? 1.0f : -1.0f;
+		float a[3], b[3], c[3];
+		for (int e = 0; e < 3; e++) {
+			int i = e, j = (e + 1) % 3;
+			a[e] = (tri->y[i] - tri->y[j]) * sign;
+			b[e] = (tri->x[j] - tri->x[i]) * sign;
+			c[e] = (tri->x[i] * tri->y[j] - tri->x[j] * tri->y[i]) * sign;
+		}
+
+		// Depth plane z = dz_dx * x + dz_dy * y + z_c.
+		float dz_dx = ((tri->z[1] - tri->z[0]) * (tri->y[2] - tri->y[0]) - (tri->z[2] - tri->z[0]) * (tri->y[1] - tri->y[0])) / area;
+		float dz_dy = ((tri->z[2] - tri->z[0]) * (tri->x[1] - tri->x[0]) - (tri->z[1] - tri->z[0]) * (tri->x[2] - tri->x[0])) / area;
+		float z_c = tri->z[0] - dz_dx * tri->x[0] - dz_dy * tri->y[0];
+
+		float min_x = glm_min(glm_min(tri->x[0], tri->x[1]), tri->x[2]);
+		float max_x = glm_max(glm_max(tri->x[0], tri->x[1]), tri->x[2]);
+		int tile_x0 = glm_max((int)floorf(min_x), 0) / SOFT_TILE_SIZE;
+		int tile_x1 = glm_min((int)ceilf(max_x), occlusion->width - 1) / SOFT_TILE_SIZE;
+		int y0 = glm_max(tri->min_y, band_y0);
+		int y1 = glm_min(tri->max_y, band_y1);
+
+		for (int y = y0; y <= y1; y++) {
+			float py = y + 0.5f;
+			vfloat e0_row = v_set1(b[0] * py + c[0]);
+			vfloat e1_row = v_set1(b[1] * py + c[1]);
+			vfloat e2_row = v_set1(b[2] * py + c[2]);
+			vfloat z_row = v_set1(dz_dy * py + z_c);
+			for (int tx = tile_x0; tx <= tile_x1; tx++) {
+				float *row = band + tx * SOFT_TILE_PIXELS + (y - band_y0) * SOFT_TILE_SIZE;
+				for (int lx = 0; lx < SOFT_TILE_SIZE; lx += SIMD_WIDTH) {
+					vfloat px = v_add(v_set1(tx * SOFT_TILE_SIZE + lx + 0.5f), lanes);
+					vfloat inside = v_and(v_and(
+						v_ge(v_add(v_mul(v_set1(a[0]), px), e0_row), zero),
+						v_ge(v_add(v_mul(v_set1(a[1]), px), e1_row), zero)),
+						v_ge(v_add(v_mul(v_set1(a[2]), px), e2_row), zero));
+					vfloat z = v_add(v_mul(v_set1(dz_dx), px), z_row);
+					vfloat depth = v_load(row + lx);
+					v_store(row + lx, v_select(inside, v_min(depth, z), depth));
+				}
+			}
+		}
+	}
+
+	for (int tx = 0; tx < occlusion->tiles_x; tx++) {
+		const float *tile = band + tx * SOFT_TILE_PIXELS;
+		float max_depth = 0.0f;
+		for (int i = 0; i < SOFT_TILE_PIXELS; i++) {
+			max_depth = glm_max(max_depth, tile[i]);
+		}
+		occlusion->tile_max[tile_row * occlusion->tiles_x + tx] = max_depth;
+	}
+}
+
+// Rasterize the queued occluders, one row of tiles per job.
+void soft_occlusion_rasterize(SoftOcclusion *occlusion) {
+	jobs_run(occlusion->jobs, rasterize_band, occlusion, occlusion->tiles_y);
+}
+
+// Whether any part of the box may be visible. Conservative: the box's screen
+// rectangle at its nearest depth is tested, and boxes crossing the near plane
+// always pass.
+int soft_occlusion_test_aabb(const SoftOcclusion *occlusion, vec3 box[2]) {
+	float min_x = FLT_MAX, max_x = -FLT_MAX, min_y = FLT_MAX, max_y = -FLT_MAX, min_z = FLT_MAX;
+	for (int corner = 0; corner < 8; corner++) {
+		vec4 clip;
+		glm_mat4_mulv((vec4 *)occlusion->view_proj, (vec4){box[corner & 1][0], box[(corner >> 1) & 1][1], box[corner >> 2][2], 1.0f}, clip);
+		if (clip[2] < -clip[3]) {
+			return 1;
+		}
+		float inv_w = 1.0f / clip[3];
+		float x = (clip[0] * inv_w * 0.5f + 0.5f) * occlusion->width;
+		float y = (clip[1] * inv_w * 0.5f + 0.5f) * occlusion->height;
+		min_x = glm_min(min_x, x);
+		max_x = glm_max(max_x, x);
+		min_y = glm_min(min_y, y);
+		max_y = glm_max(max_y, y);
+		min_z = glm_min(min_z, clip[2] * inv_w * 0.5f + 0.5f);
+	}
+
+	int x0 = glm_max((int)floorf(min_x), 0);
+	int x1 = glm_min((int)floorf(max_x), occlusion->width - 1);
+	int y0 = glm_max((int)floorf(min_y), 0);
+	int y1 = glm_min((int)floorf(max_y), occlusion->height - 1);
+	if (x0 > x1 || y0 > y1) {
+		return 0; // Off screen.
+	}
+
+	vfloat lanes = v_load(lane_offsets);
+	vfloat box_z = v_set1(min_z);
+	vfloat rect_x0 = v_set1((float)x0);
+	vfloat rect_x1 = v_set1((float)x1);
+	for (int ty = y0 / SOFT_TILE_SIZE; ty <= y1 / SOFT_TILE_SIZE; ty++) {
+		for (int tx = x0 / SOFT_TILE_SIZE; tx <= x1 / SOFT_TILE_SIZE; tx++) {
+			int tile = ty * occlusion->tiles_x + tx;
+			if (occlusion->tile_max[tile] < min_z) {
+				continue; // Everything in this tile is nearer than the box.
+			}
+			int tile_x = tx * SOFT_TILE_SIZE;
+			int tile_y = ty * SOFT_TILE_SIZE;
+			if (tile_x >= x0 && tile_x + SOFT_TILE_SIZE - 1 <= x1 && tile_y >= y0 && tile_y + SOFT_TILE_SIZE - 1 <= y1) {
+				return 1; // The farthest pixel is inside the rectangle.
+			}
+
+			const float *depth = occlusion->depth + tile * SOFT_TILE_PIXELS;
+			for (int y = glm_max(y0, tile_y); y <= glm_min(y1, tile_y + SOFT_TILE_SIZE - 1); y++) {
+				const float *row = depth + (y - tile_y) * SOFT_TILE_SIZE;
+				for (int lx = 0; lx < SOFT_TILE_SIZE; lx += SIMD_WIDTH) {
+					vfloat px = v_add(v_set1((float)(tile_x + lx)), lanes);
+					vfloat in_rect = v_and(v_ge(px, rect_x0), v_ge(rect_x1, px));
+					if (v_movemask(v_and(in_rect, v_ge(v_load(row + lx), box_z)))) {
+						return 1;
+					}
+				}
+			}
+		}
+	}
+	return 0;
+}
+
+typedef struct {
+	SoftOcclusion *occlusion;
+	vec3 (*boxes)[2];
+	const int *candidates;
+	int count;
+} SoftTestBatch;
+
+// JobFn: test SOFT_TEST_BATCH candidates.
+static void test_batch(void *ctx, int batch) {
+	SoftTestBatch *test = ctx;
+	int end = glm_min((batch + 1) * SOFT_TEST_BATCH, test->count);
+	for (int i = batch * SOFT_TEST_BATCH; i < end; i++) {
+		test->occlusion->results[i] = (char)soft_occlusion_test_aabb(test->occlusion, test->boxes[test->candidates[i]]);
+	}
+}
+
+// Test the candidate objects' boxes on the worker threads and write the ones that
+// may be visible to `visible`, which may be `candidates` itself. Returns their count.
+int soft_occlusion_test(SoftOcclusion *occlusion, vec3 (*boxes)[2], const int *candidates, int count, int *visible) {
+	if (count > occlusion->result_capacity) {
+		occlusion->result_capacity = count;
+		occlusion->results = realloc(occlusion->results, count);
+	}
+
+	SoftTestBatch test = {occlusion, boxes, candidates, count};
+	jobs_run(occlusion->jobs, test_batch, &test, (count + SOFT_TEST_BATCH - 1) / SOFT_TEST_BATCH);
+
+	int visible_count = 0;
+	for (int i = 0; i < count; i++) {
+		if (occlusion->results[i]) {
+			visible[visible_count++] = candidates[i];
+		}
+	}
+	return visible_count;
+}
+
+void soft_occlusion_destroy(SoftOcclusion *occlusion) {
+	free(occlusion->depth);
+	free(occlusion->tile_max);
+	free(occlusion->triangles);
+	free(occlusion->results);
+	memset(occlusion, 0, sizeof(*occlusion));
+}
+
+static double elapsed_ms(Uint64 start) {
+	return (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+// Rasterize a wall in front of `count` random boxes and test them all, printing
+// timings and how many were hidden. Runs entirely on the CPU.
+void soft_occlusion_benchmark(int count) {
+	const int runs = 20;
+	static const float wall[] = {
+		-6.0f, -6.0f, -10.0f,   6.0f, -6.0f, -10.0f,   6.0f, 6.0f, -10.0f,
+		 6.0f,  6.0f, -10.0f,  -6.0f,  6.0f, -10.0f,  -6.0f, -6.0f, -10.0f
+	};
+
+	vec3 (*boxes)[2] = malloc(count * sizeof(*boxes));
+	int *candidates = malloc(count * sizeof(int));
+	int *visible = malloc(count * sizeof(int));
+	srand(1);
+	for (int i = 0; i < count; i++) {
+		vec3 center = {rand() % 2000 / 100.0f - 10.0f, rand() % 2000 / 100.0f - 10.0f, -2.0f - rand() % 9800 / 100.0f};
+		glm_vec3_subs(center, 0.25f, boxes[i][0]);
+		glm_vec3_adds(center, 0.25f, boxes[i][1]);
+		candidates[i] = i;
+	}
+
+	// Camera at the origin looking down -z.
+	mat4 view, proj, view_proj, model = GLM_MAT4_IDENTITY_INIT;
+	glm_lookat((vec3){0.0f, 0.0f, 0.0f}, (vec3){0.0f, 0.0f, -1.0f}, (vec3){0.0f, 1.0f, 0.0f}, view);
+	glm_perspective(glm_rad(60.0f), 1.0f, 0.1f, 100.0f, proj);
+	glm_mat4_mul(proj, view, view_proj);
+
+	JobSystem *jobs = jobs_create(0);
+	SoftOcclusion occlusion = soft_occlusion_create(256, 256, jobs);
+
+	Uint64 start = SDL_GetPerformanceCounter();
+	for (int run = 0; run < runs; run++) {
+		soft_occlusion_begin(&occlusion, view_proj);
+		soft_occlusion_add_occluder(&occlusion, wall, NULL, 6, 3, model);
+		soft_occlusion_rasterize(&occlusion);
+	}
+	double raster_ms = elapsed_ms(start) / runs;
+
+	int visible_count = 0;
+	start = SDL_GetPerformanceCounter();
+	for (int run = 0; run < runs; run++) {
+		visible_count = soft_occlusion_test(&occlusion, boxes, candidates, count, visible);
+	}
+	double test_ms = elapsed_ms(start) / runs;
+
+	printf("Software occlusion benchmark, %dx%d depth buffer, %d lanes, %d threads:\n",
+		occlusion.width, occlusion.height, SIMD_WIDTH, jobs_thread_count(jobs));
+	printf("  Rasterize: %8.3f ms (%d triangles)\n", raster_ms, occlusion.triangle_count);
+	printf("  Test:      %8.3f ms (%d of %d boxes visible)\n", test_ms, visible_count, count);
+
+	// Cleanup.
+	soft_occlusion_destroy(&occlusion);
+	jobs_destroy(jobs);
+	free(visible);
+	free(candidates);
+	free(boxes);
+}
@@ -0,0 +1,43 @@
+#ifndef SOFT_OCCLUSION_H
+#define SOFT_OCCLUSION_H
+
+#include <cglm/cglm.h>
+#include "jobs.h"
+
+// Pixels per side of a depth buffer tile. Tiles are stored contiguously, row
+// by row, so one tile is a few cache lines.
+#define SOFT_TILE_SIZE 8
+
+// Occluder triangle in screen space. Depth is z_ndc mapped to [0, 1] and is
+// linear over the screen.
+typedef struct {
+	float x[3], y[3], z[3];
+	int min_y, max_y; // Pixel rows covered, inclusive.
+} SoftTriangle;
+
+// CPU occlusion culling: a few big occluders are rasterized into a small depth
+// buffer, then boxes are tested against it. Needs no GPU at all.
+typedef struct {
+	float *depth;    // Tile major, SOFT_TILE_SIZE^2 floats per tile. 0 near, 1 far.
+	float *tile_max; // Farthest depth in each tile.
+	int width, height; // Multiples of SOFT_TILE_SIZE.
+	int tiles_x, tiles_y;
+	mat4 view_proj;
+	SoftTriangle *triangles;
+	int triangle_count;
+	int triangle_capacity;
+	JobSystem *jobs;
+	char *results; // Per candidate visibility, filled by the test jobs.
+	int result_capacity;
+} SoftOcclusion;
+
+SoftOcclusion soft_occlusion_create(int width, int height, JobSystem *jobs);
+void soft_occlusion_begin(SoftOcclusion *occlusion, mat4 view_proj);
+void soft_occlusion_add_occluder(SoftOcclusion *occlusion, const float *vertices, const unsigned int *indices, int index_count, int stride, mat4 model);
+void soft_occlusion_rasterize(SoftOcclusion *occlusion);
+int soft_occlusion_test_aabb(const SoftOcclusion *occlusion, vec3 box[2]);
+int soft_occlusion_test(SoftOcclusion *occlusion, vec3 (*boxes)[2], const int *candidates, int count, int *visible);
+void soft_occlusion_destroy(SoftOcclusion *occlusion);
+void soft_occlusion_benchmark(int count);
+
+#endif
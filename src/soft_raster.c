@@ -0,0 +1,338 @@
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "soft_raster.h"
+#include "ppm.h"
+#include "simd.h"
+
+#define SOFT_UNIFORM_ALIGN 16
+
+// Pixel offsets within one vector. SOFT_RASTER_TILE is a multiple of SIMD_WIDTH.
+static const float lane_offsets[8] = {0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f};
+
+SoftRaster soft_raster_create(int width, int height, JobSystem *jobs) {
+	SoftRaster raster = {0};
+	raster.width = width;
+	raster.height = height;
+	raster.tiles_x = (width + SOFT_RASTER_TILE - 1) / SOFT_RASTER_TILE;
+	raster.tiles_y = (height + SOFT_RASTER_TILE - 1) / SOFT_RASTER_TILE;
+	raster.pitch = raster.tiles_x * SOFT_RASTER_TILE;
+	raster.color = malloc(raster.pitch * raster.tiles_y * SOFT_RASTER_TILE * sizeof(uint32_t));
+	raster.depth = malloc(raster.pitch * raster.tiles_y * SOFT_RASTER_TILE * sizeof(float));
+	raster.bins = calloc(raster.tiles_x * raster.tiles_y, sizeof(SoftRasterBin));
+	raster.jobs = jobs;
+	return raster;
+}
+
+static uint32_t pack_color(vec4 color) {
+	uint32_t r = (uint32_t)(glm_clamp(color[0], 0.0f, 1.0f) * 255.0f + 0.5f);
+	uint32_t g = (uint32_t)(glm_clamp(color[1], 0.0f, 1.0f) * 255.0f + 0.5f);
+	uint32_t b = (uint32_t)(glm_clamp(color[2], 0.0f, 1.0f) * 255.0f + 0.5f);
+	return 0xff000000u | r << 16 | g << 8 | b;
+}
+
+// Start a frame. Tiles are cleared when they are rasterized.
+void soft_raster_begin(SoftRaster *raster, vec4 clear_color) {
+	raster->clear_color = pack_color(clear_color);
+	raster->triangle_count = 0;
+	raster->plane_count = 0;
+	raster->uniform_size = 0;
+	for (int i = 0; i < raster->tiles_x * raster->tiles_y; i++) {
+		raster->bins[i].count = 0;
+	}
+}
+
+// Coefficients of the screen space plane through (x, y, f) at the three corners.
+static void plane(const float x[3], const float y[3], const float f[3], float area, float dest[3]) {
+	dest[0] = ((f[1] - f[0]) * (y[2] - y[0]) - (f[2] - f[0]) * (y[1] - y[0])) / area;
+	dest[1] = ((f[2] - f[0]) * (x[1] - x[0]) - (f[1] - f[0]) * (x[2] - x[0])) / area;
+	dest[2] = f[0] - dest[0] * x[0] - dest[1] * y[0];
+}
+
+// Set up a triangle in front of the near plane and add it to the bins it touches.
+static void setup_triangle(SoftRaster *raster, const SoftVertex *corners[3], const SoftProgram *program, int uniforms) {
+	float x[3], y[3], z[3], inv_w[3];
+	float min_x = FLT_MAX, max_x = -FLT_MAX, min_y = FLT_MAX, max_y = -FLT_MAX;
+	for (int k = 0; k < 3; k++) {
+		const float *clip = corners[k]->clip;
+		inv_w[k] = 1.0f / clip[3];
+		x[k] = (clip[0] * inv_w[k] * 0.5f + 0.5f) * raster->width;
+		y[k] = (0.5f - clip[1] * inv_w[k] * 0.5f) * raster->height; // Top row first.
+		z[k] = clip[2] * inv_w[k] * 0.5f + 0.5f;
+		min_x = glm_min(min_x, x[k]);
+		max_x = glm_max(max_x, x[k]);
+		min_y = glm_min(min_y, y[k]);
+		max_y = glm_max(max_y, y[k]);
+	}
+
+	float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	if (fabsf(area) < 1e-6f || max_x < 0.0f || min_x > raster->width || max_y < 0.0f || min_y > raster->height) {
+		return; // Degenerate or off screen.
+	}
+	SoftRasterTriangle triangle;
+	triangle.min_x = glm_max((int)floorf(min_x), 0);
+	triangle.max_x = glm_min((int)ceilf(max_x), raster->width - 1);
+	triangle.min_y = glm_max((int)floorf(min_y), 0);
+	triangle.max_y = glm_min((int)ceilf(max_y), raster->height - 1);
+	triangle.program = program;
+	triangle.uniforms = uniforms;
+
+	// Edge functions, positive inside whatever the winding.
+	float sign = area > 0.0f ? 1.0f : -1.0f;
+	for (int e = 0; e < 3; e++) {
+		int i = e, j = (e + 1) % 3;
+		triangle.edges[e][0] = (y[i] - y[j]) * sign;
+		triangle.edges[e][1] = (x[j] - x[i]) * sign;
+		triangle.edges[e][2] = (x[i] * y[j] - x[j] * y[i]) * sign;
+	}
+	plane(x, y, z, area, triangle.depth);
+
+	// 1/w and varying/w are linear over the screen, unlike the varyings themselves.
+	int plane_floats = 3 * (1 + program->varying_count);
+	if (raster->plane_count + plane_floats > raster->plane_capacity) {
+		raster->plane_capacity = raster->plane_capacity ? raster->plane_capacity * 2 : 4096;
+		raster->planes = realloc(raster->planes, raster->plane_capacity * sizeof(float));
+	}
+	triangle.planes = raster->plane_count;
+	float *planes = raster->planes + raster->plane_count;
+	raster->plane_count += plane_floats;
+	plane(x, y, inv_w, area, planes);
+	for (int v = 0; v < program->varying_count; v++) {
+		float f[3];
+		for (int k = 0; k < 3; k++) {
+			f[k] = corners[k]->varyings[v] * inv_w[k];
+		}
+		plane(x, y, f, area, planes + 3 * (v + 1));
+	}
+
+	if (raster->triangle_count == raster->triangle_capacity) {
+		raster->triangle_capacity = raster->triangle_capacity ? raster->triangle_capacity * 2 : 1024;
+		raster->triangles = realloc(raster->triangles, raster->triangle_capacity * sizeof(SoftRasterTriangle));
+	}
+	int index = raster->triangle_count++;
+	raster->triangles[index] = triangle;
+
+	for (int ty = triangle.min_y / SOFT_RASTER_TILE; ty <= triangle.max_y / SOFT_RASTER_TILE; ty++) {
+		for (int tx = triangle.min_x / SOFT_RASTER_TILE; tx <= triangle.max_x / SOFT_RASTER_TILE; tx++) {
+			SoftRasterBin *bin = &raster->bins[ty * raster->tiles_x + tx];
+			if (bin->count == bin->capacity) {
+				bin->capacity = bin->capacity ? bin->capacity * 2 : 64;
+				bin->triangles = realloc(bin->triangles, bin->capacity * sizeof(int));
+			}
+			bin->triangles[bin->count++] = index;
+		}
+	}
+}
+
+static void lerp_vertex(const SoftVertex *a, const SoftVertex *b, float t, int varying_count, SoftVertex *dest) {
+	glm_vec4_lerp((float *)a->clip, (float *)b->clip, t, dest->clip);
+	for (int v = 0; v < varying_count; v++) {
+		dest->varyings[v] = a->varyings[v] + (b->varyings[v] - a->varyings[v]) * t;
+	}
+}
+
+// Run the vertex shader over a mesh level of detail and queue its triangles.
+// Triangles crossing the near plane are clipped against it. `uniforms` is copied,
+// `program` must stay valid until soft_raster_end().
+void soft_raster_draw(SoftRaster *raster, const MeshData *mesh, int lod, const SoftProgram *program, const void *uniforms, int uniform_size) {
+	if (program->varying_count > SOFT_MAX_VARYINGS) {
+		printf("Software program has %d varyings, at most %d are supported\n", program->varying_count, SOFT_MAX_VARYINGS);
+		return;
+	}
+	if (raster->uniform_size + uniform_size + SOFT_UNIFORM_ALIGN > raster->uniform_capacity) {
+		raster->uniform_capacity = (raster->uniform_size + uniform_size + SOFT_UNIFORM_ALIGN) * 2;
+		raster->uniforms = realloc(raster->uniforms, raster->uniform_capacity);
+	}
+	int uniform_offset = raster->uniform_size;
+	memcpy(raster->uniforms + uniform_offset, uniforms, uniform_size);
+	raster->uniform_size += (uniform_size + SOFT_UNIFORM_ALIGN - 1) & ~(SOFT_UNIFORM_ALIGN - 1);
+
+	if (mesh->vertex_count > raster->vertex_capacity) {
+		raster->vertex_capacity = mesh->vertex_count;
+		raster->vertices = realloc(raster->vertices, raster->vertex_capacity * sizeof(SoftVertex));
+	}
+	for (int i = 0; i < mesh->vertex_count; i++) {
+		SoftVertex *vertex = &raster->vertices[i];
+		program->vertex(uniforms, mesh->vertices + i * mesh->stride, vertex->clip, vertex->varyings);
+	}
+
+	int first = 0, count = mesh->index_count;
+	if (mesh->lod_count > 0) {
+		lod = lod < 0 ? 0 : (lod < mesh->lod_count ? lod : mesh->lod_count - 1);
+		first = mesh->lods[lod].first_index;
+		count = mesh->lods[lod].index_count;
+	}
+	const unsigned int *indices = mesh->indices + first;
+	for (int t = 0; t + 2 < count; t += 3) {
+		const SoftVertex *corners[3];
+		float near_dist[3];
+		int inside = 0;
+		for (int k = 0; k < 3; k++) {
+			corners[k] = &raster->vertices[indices[t + k]];
+			near_dist[k] = corners[k]->clip[2] + corners[k]->clip[3]; // z_ndc >= -1.
+			inside += near_dist[k] >= 0.0f;
+		}
+
+		if (inside == 3) {
+			setup_triangle(raster, corners, program, uniform_offset);
+		} else if (inside > 0) {
+			// One clipped corner leaves a quad, two leave a smaller triangle.
+			SoftVertex polygon[4];
+			int n = 0;
+			for (int k = 0; k < 3; k++) {
+				int next = (k + 1) % 3;
+				if (near_dist[k] >= 0.0f) {
+					polygon[n++] = *corners[k];
+				}
+				if ((near_dist[k] >= 0.0f) != (near_dist[next] >= 0.0f)) {
+					lerp_vertex(corners[k], corners[next], near_dist[k] / (near_dist[k] - near_dist[next]), program->varying_count, &polygon[n++]);
+				}
+			}
+			const SoftVertex *first_half[3] = {&polygon[0], &polygon[1], &polygon[2]};
+			setup_triangle(raster, first_half, program, uniform_offset);
+			if (n == 4) {
+				const SoftVertex *second_half[3] = {&polygon[0], &polygon[2], &polygon[3]};
+				setup_triangle(raster, second_half, program, uniform_offset);
+			}
+		}
+	}
+}
+
+// Interpolate a covered pixel's varyings and run the fragment shader.
+static void shade(SoftRaster *raster, const SoftRasterTriangle *triangle, int x, int y, float depth) {
+	SoftFragment fragment;
+	fragment.x = x + 0.5f;
+	fragment.y = y + 0.5f;
+	fragment.depth = depth;
+	const float *inv_w = raster->planes + triangle->planes;
+	float w = 1.0f / (inv_w[0] * fragment.x + inv_w[1] * fragment.y + inv_w[2]);
+	for (int v = 0; v < triangle->program->varying_count; v++) {
+		const float *p = inv_w + 3 * (v + 1);
+		float value = (p[0] * fragment.x + p[1] * fragment.y + p[2]) * w;
+		fragment.varyings[v] = value;
+		fragment.ddx[v] = (p[0] - value * inv_w[0]) * w;
+		fragment.ddy[v] = -(p[1] - value * inv_w[1]) * w; // Rows go down, GL's y goes up.
+	}
+
+	vec4 color;
+	triangle->program->fragment(raster->uniforms + triangle->uniforms, &fragment, color);
+	raster->color[y * raster->pitch + x] = pack_color(color);
+}
+
+// JobFn: clear one tile and rasterize its bin. Tiles never share pixels, so no
+// locking is needed.
+static void rasterize_tile(void *ctx, int tile) {
+	SoftRaster *raster = ctx;
+	int tile_x = tile % raster->tiles_x * SOFT_RASTER_TILE;
+	int tile_y = tile / raster->tiles_x * SOFT_RASTER_TILE;
+	for (int y = tile_y; y < tile_y + SOFT_RASTER_TILE; y++) {
+		for (int x = tile_x; x < tile_x + SOFT_RASTER_TILE; x++) {
+			raster->color[y * raster->pitch + x] = raster->clear_color;
+			raster->depth[y * raster->pitch + x] = 1.0f;
+		}
+	}
+
+	const SoftRasterBin *bin = &raster->bins[tile];
+	vfloat lanes = v_load(lane_offsets);
+	vfloat zero = v_set1(0.0f);
+	for (int i = 0; i < bin->count; i++) {
+		const SoftRasterTriangle *tri = &raster->triangles[bin->triangles[i]];
+		int x0 = glm_max(tri->min_x, tile_x) / SIMD_WIDTH * SIMD_WIDTH;
+		int x1 = glm_min(tri->max_x, tile_x + SOFT_RASTER_TILE - 1);
+		int y0 = glm_max(tri->min_y, tile_y);
+		int y1 = glm_min(tri->max_y, tile_y + SOFT_RASTER_TILE - 1);
+		vfloat a0 = v_set1(tri->edges[0][0]), a1 = v_set1(tri->edges[1][0]), a2 = v_set1(tri->edges[2][0]);
+		vfloat dz_dx = v_set1(tri->depth[0]);
+
+		for (int y = y0; y <= y1; y++) {
+			float py = y + 0.5f;
+			vfloat e0_row = v_set1(tri->edges[0][1] * py + tri->edges[0][2]);
+			vfloat e1_row = v_set1(tri->edges[1][1] * py + tri->edges[1][2]);
+			vfloat e2_row = v_set1(tri->edges[2][1] * py + tri->edges[2][2]);
+			vfloat z_row = v_set1(tri->depth[1] * py + tri->depth[2]);
+			float *depth_row = raster->depth + y * raster->pitch;
+			for (int x = x0; x <= x1; x += SIMD_WIDTH) {
+				vfloat px = v_add(v_set1(x + 0.5f), lanes);
+				vfloat inside = v_and(v_and(
+					v_ge(v_add(v_mul(a0, px), e0_row), zero),
+					v_ge(v_add(v_mul(a1, px), e1_row), zero)),
+					v_ge(v_add(v_mul(a2, px), e2_row), zero));
+				vfloat z = v_add(v_mul(dz_dx, px), z_row);
+				vfloat depth = v_load(depth_row + x);
+				vfloat pass = v_select(v_ge(z, depth), zero, inside); // GL_LESS.
+				int mask = v_movemask(pass);
+				if (!mask) {
+					continue;
+				}
+				v_store(depth_row + x, v_select(pass, z, depth));
+
+				float lane_z[8];
+				v_store(lane_z, z);
+				for (int lane = 0; lane < SIMD_WIDTH; lane++) {
+					if (mask & (1 << lane)) {
+						shade(raster, tri, x + lane, y, lane_z[lane]);
+					}
+				}
+			}
+		}
+	}
+}
+
+// Rasterize everything drawn since soft_raster_begin(), one tile per job.
+void soft_raster_end(SoftRaster *raster) {
+	jobs_run(raster->jobs, rasterize_tile, raster, raster->tiles_x * raster->tiles_y);
+}
+
+// Copy the color buffer to a window without an OpenGL context and show it.
+// Returns 0 if the window has no surface.
+int soft_raster_present(const SoftRaster *raster, SDL_Window *window) {
+	SDL_Surface *surface = SDL_GetWindowSurface(window);
+	if (!surface) {
+		printf("Window has no surface, error: %s\n", SDL_GetError());
+		return 0;
+	}
+	int width = glm_min(raster->width, surface->w);
+	int height = glm_min(raster->height, surface->h);
+	if (SDL_MUSTLOCK(surface)) {
+		SDL_LockSurface(surface);
+	}
+	int converted = SDL_ConvertPixels(width, height, SDL_PIXELFORMAT_ARGB8888, raster->color, raster->pitch * sizeof(uint32_t),
+		surface->format->format, surface->pixels, surface->pitch) == 0;
+	if (SDL_MUSTLOCK(surface)) {
+		SDL_UnlockSurface(surface);
+	}
+	return converted && SDL_UpdateWindowSurface(window) == 0;
+}
+
+// Write the color buffer as a binary PPM. Returns 0 if the file could not be written.
+int soft_raster_write_ppm(const SoftRaster *raster, const char *path) {
+	unsigned char *rgb = malloc((size_t)raster->width * raster->height * 3);
+	unsigned char *pixel = rgb;
+	for (int y = 0; y < raster->height; y++) {
+		for (int x = 0; x < raster->width; x++) {
+			uint32_t color = raster->color[y * raster->pitch + x];
+			*pixel++ = (unsigned char)(color >> 16);
+			*pixel++ = (unsigned char)(color >> 8);
+			*pixel++ = (unsigned char)color;
+		}
+	}
+	int ok = ppm_write(path, raster->width, raster->height, rgb, (size_t)raster->width * 3, 0);
+	free(rgb);
+	return ok;
+}
+
+void soft_raster_destroy(SoftRaster *raster) {
+	for (int i = 0; i < raster->tiles_x * raster->tiles_y; i++) {
+		free(raster->bins[i].triangles);
+	}
+	free(raster->bins);
+	free(raster->color);
+	free(raster->depth);
+	free(raster->triangles);
+	free(raster->planes);
+	free(raster->uniforms);
+	free(raster->vertices);
+	memset(raster, 0, sizeof(*raster));
+}
@@ -0,0 +1,92 @@
+#ifndef SOFT_RASTER_H
+#define SOFT_RASTER_H
+
+#include <SDL2/SDL.h>
+#include <cglm/cglm.h>
+#include <stdint.h>
+#include "jobs.h"
+#include "mesh.h"
+
+// Pixels per side of a bin. Each tile is rasterized by one job.
+#define SOFT_RASTER_TILE 64
+#define SOFT_MAX_VARYINGS 8 // Floats a vertex shader can pass to the fragment shader.
+
+// What the fragment shader gets for one pixel. Varyings are interpolated
+// perspective correct; `ddx` and `ddy` are their screen space derivatives, like
+// dFdx() and dFdy() with y pointing up.
+typedef struct {
+	float x, y;  // Pixel center, y down from the top row.
+	float depth; // Window space, 0 near, 1 far.
+	float varyings[SOFT_MAX_VARYINGS];
+	float ddx[SOFT_MAX_VARYINGS];
+	float ddy[SOFT_MAX_VARYINGS];
+} SoftFragment;
+
+// Shaders are plain C callbacks. `vertex` points at `stride` floats of a
+// MeshData vertex, position first.
+typedef void (*SoftVertexFn)(const void *uniforms, const float *vertex, vec4 clip, float *varyings);
+typedef void (*SoftFragmentFn)(const void *uniforms, const SoftFragment *fragment, vec4 color);
+
+typedef struct {
+	SoftVertexFn vertex;
+	SoftFragmentFn fragment;
+	int varying_count;
+} SoftProgram;
+
+// Vertex shader output.
+typedef struct {
+	vec4 clip;
+	float varyings[SOFT_MAX_VARYINGS];
+} SoftVertex;
+
+// A triangle set up for rasterization: edge functions and the planes of depth,
+// 1/w and every varying/w over the screen.
+typedef struct {
+	float edges[3][3]; // a * x + b * y + c, positive inside.
+	float depth[3];    // Plane z = [0] * x + [1] * y + [2].
+	int min_x, min_y, max_x, max_y; // Pixel bounds on screen, inclusive.
+	int planes;        // Offset in SoftRaster.planes of 1/w, then each varying/w.
+	int uniforms;      // Offset in SoftRaster.uniforms.
+	const SoftProgram *program;
+} SoftRasterTriangle;
+
+typedef struct {
+	int *triangles; // In submission order.
+	int count;
+	int capacity;
+} SoftRasterBin;
+
+// Tile binned CPU rasterizer. Draws transform and set up their triangles on the
+// calling thread and bin them into SOFT_RASTER_TILE tiles; soft_raster_end()
+// then rasterizes every tile on the job system, with SIMD edge functions and
+// depth tests. Each tile draws its triangles in submission order, so the image
+// doesn't depend on the thread count.
+typedef struct {
+	uint32_t *color; // ARGB8888, `pitch` pixels per row, top row first.
+	float *depth;
+	int width, height;
+	int pitch; // Rounded up to whole tiles, as are the rows.
+	int tiles_x, tiles_y;
+	JobSystem *jobs;
+	uint32_t clear_color;
+
+	SoftRasterTriangle *triangles;
+	int triangle_count, triangle_capacity;
+	float *planes;
+	int plane_count, plane_capacity;
+	unsigned char *uniforms; // Copies of each draw's uniforms.
+	int uniform_size, uniform_capacity;
+	SoftVertex *vertices; // Transformed vertices of the current draw.
+	int vertex_capacity;
+	SoftRasterBin *bins;
+} SoftRaster;
+
+SoftRaster soft_raster_create(int width, int height, JobSystem *jobs);
+void soft_raster_begin(SoftRaster *raster, vec4 clear_color);
+void soft_raster_draw(SoftRaster *raster, const MeshData *mesh, int lod, const SoftProgram *program, const void *uniforms, int uniform_size);
+void soft_raster_end(SoftRaster *raster);
+int soft_raster_present(const SoftRaster *raster, SDL_Window *window);
+int soft_raster_write_ppm(const SoftRaster *raster, const char *path);
+void soft_raster_destroy(SoftRaster *raster);
+
+#endif
@@ -0,0 +1,40 @@
+#include <math.h>
+#include "soft_scene.h"
+
+#define AMBIENT 0.1f
+#define SHININESS 32.0f
+
+// Passes the world position on, for the flat normal.
+static void scene_vertex(const void *uniforms, const float *vertex, vec4 clip, float *varyings) {
+	const SoftSceneUniforms *scene = uniforms;
+	vec4 pos = {vertex[0], vertex[1], vertex[2], 1.0f};
+	vec4 world;
+	glm_mat4_mulv((vec4 *)scene->model, pos, world);
+	glm_mat4_mulv((vec4 *)scene->mvp, pos, clip);
+	glm_vec3_copy(world, varyings);
+}
+
+static void scene_fragment(const void *uniforms, const SoftFragment *fragment, vec4 color) {
+	const SoftSceneUniforms *scene = uniforms;
+	// Flat shading, the cube has no vertex normals.
+	vec3 world_pos, normal, to_eye, half;
+	glm_vec3_copy((float *)fragment->varyings, world_pos);
+	glm_vec3_cross((float *)fragment->ddx, (float *)fragment->ddy, normal);
+	glm_vec3_normalize(normal);
+	glm_vec3_sub((float *)scene->cam_pos, world_pos, to_eye);
+	glm_vec3_normalize(to_eye);
+
+	glm_vec3_scale((float *)scene->color, AMBIENT, color);
+	float sun = glm_vec3_dot(normal, (float *)scene->sun_dir);
+	if (sun > 0.0f) {
+		glm_vec3_add((float *)scene->sun_dir, to_eye, half);
+		glm_vec3_normalize(half);
+		float highlight = powf(fmaxf(glm_vec3_dot(normal, half), 0.0f), SHININESS);
+		for (int k = 0; k < 3; k++) {
+			color[k] += (scene->color[k] * sun + scene->color[3] * highlight) * scene->sun_color[k];
+		}
+	}
+	color[3] = 1.0f;
+}
+
+const SoftProgram soft_scene_program = {scene_vertex, scene_fragment, 3};
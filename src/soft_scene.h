@@ -0,0 +1,21 @@
+#ifndef SOFT_SCENE_H
+#define SOFT_SCENE_H
+
+#include <cglm/cglm.h>
+#include "soft_raster.h"
+
+// Uniforms of soft_scene_program.
+typedef struct {
+	mat4 mvp;
+	mat4 model;
+	vec4 color;     // Albedo, specular strength in alpha, like DrawUniforms.
+	vec4 cam_pos;
+	vec4 sun_dir;   // Towards the sun.
+	vec4 sun_color;
+} SoftSceneUniforms;
+
+// scene.vert and scene.frag as C callbacks: flat shaded Blinn-Phong under the
+// sun, without shadows or point lights.
+extern const SoftProgram soft_scene_program;
+
+#endif
@@ -0,0 +1,139 @@
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <string.h>
+#include "stream.h"
+
+// ARB_buffer_storage is core in 4.4, past what glad was generated for.
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+
+static PFNGLBUFFERSTORAGEPROC buffer_storage(void) {
+	static int loaded = 0;
+	static PFNGLBUFFERSTORAGEPROC proc = NULL;
+	if (!loaded) {
+		loaded = 1;
+		if (SDL_GL_ExtensionSupported("GL_ARB_buffer_storage")) {
+			proc = (PFNGLBUFFERSTORAGEPROC)SDL_GL_GetProcAddress("glBufferStorage");
+		}
+	}
+	return proc;
+}
+
+StreamBuffer stream_buffer_create(GLenum target, size_t region_size) {
+	StreamBuffer stream = {0};
+	stream.target = target;
+	stream.region_size = region_size;
+	size_t size = region_size * STREAM_FRAMES;
+
+	glGenBuffers(1, &stream.buffer);
+	glBindBuffer(target, stream.buffer);
+
+	PFNGLBUFFERSTORAGEPROC glBufferStorage = buffer_storage();
+	if (glBufferStorage) {
+		// Immutable storage mapped once for the buffer's lifetime. Coherent, so
+		// writes are visible to the GPU without explicit flushes.
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(target, size, NULL, flags);
+		stream.persistent = glMapBufferRange(target, 0, size, flags);
+	} else {
+		glBufferData(target, size, NULL, GL_STREAM_DRAW);
+	}
+
+	return stream;
+}
+
+// Move to the next region, waiting only if the GPU is still reading it from
+// STREAM_FRAMES frames ago.
+void stream_buffer_begin_frame(StreamBuffer *stream) {
+	stream->frame = (stream->frame + 1) % STREAM_FRAMES;
+	stream->head = 0;
+
+	GLsync fence = stream->fences[stream->frame];
+	if (!fence) {
+		return;
+	}
+
+	GLenum status = glClientWaitSync(fence, 0, 0);
+	if (status == GL_TIMEOUT_EXPIRED) {
+		stream->stalls++;
+		do {
+			status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000); // 1 s.
+		} while (status == GL_TIMEOUT_EXPIRED);
+	}
+	if (status == GL_WAIT_FAILED) {
+		printf("Stream buffer fence wait failed!\n");
+	}
+
+	glDeleteSync(fence);
+	stream->fences[stream->frame] = NULL;
+}
+
+// Fence everything issued this frame so the region isn't reused before the GPU is done.
+void stream_buffer_end_frame(StreamBuffer *stream) {
+	stream->fences[stream->frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+// Reserve `size` bytes in the current region. Returns a write pointer and the byte
+// offset in the buffer to source from, or NULL if the region is full.
+void *stream_buffer_map(StreamBuffer *stream, size_t size, size_t alignment, size_t *offset) {
+	size_t head = (stream->head + alignment - 1) / alignment * alignment;
+	if (head + size > stream->region_size) {
+		printf("Stream buffer region full! (%zu of %zu bytes used, %zu requested)\n", stream->head, stream->region_size, size);
+		return NULL;
+	}
+
+	*offset = stream->frame * stream->region_size + head;
+	stream->head = head + size;
+
+	if (stream->persistent) {
+		return stream->persistent + *offset;
+	}
+
+	// The fence already guarantees the GPU is done with this range, so skip the
+	// driver's own synchronization and let it discard the old contents.
+	glBindBuffer(stream->target, stream->buffer);
+	stream->mapped = glMapBufferRange(stream->target, *offset, size,
+		GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+	return stream->mapped;
+}
+
+void stream_buffer_unmap(StreamBuffer *stream) {
+	if (stream->persistent || !stream->mapped) {
+		return;
+	}
+
+	glBindBuffer(stream->target, stream->buffer);
+	glUnmapBuffer(stream->target);
+	stream->mapped = NULL;
+}
+
+// Copy `data` into the current region. Returns its byte offset in the buffer,
+// or (size_t)-1 if the region is full.
+size_t stream_buffer_write(StreamBuffer *stream, const void *data, size_t size, size_t alignment) {
+	size_t offset;
+	void *dest = stream_buffer_map(stream, size, alignment, &offset);
+	if (!dest) {
+		return (size_t)-1;
+	}
+
+	memcpy(dest, data, size);
+	stream_buffer_unmap(stream);
+	return offset;
+}
+
+void stream_buffer_destroy(StreamBuffer *stream) {
+	for (int i = 0; i < STREAM_FRAMES; i++) {
+		if (stream->fences[i]) {
+			glDeleteSync(stream->fences[i]);
+		}
+	}
+	if (stream->persistent) {
+		glBindBuffer(stream->target, stream->buffer);
+		glUnmapBuffer(stream->target);
+	}
+	glDeleteBuffers(1, &stream->buffer);
+	memset(stream, 0, sizeof(*stream));
+}
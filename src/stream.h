@@ -0,0 +1,33 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <glad/glad.h>
+#include <stddef.h>
+
+// Regions in flight. The CPU writes one while the GPU reads the other two.
+#define STREAM_FRAMES 3
+
+// Ring allocator over one large buffer for per-frame data (particles, debug lines, UI).
+// Each frame writes into its own region, fenced at end of frame, so uploads never
+// touch memory the GPU may still be reading.
+typedef struct {
+	unsigned int buffer;
+	GLenum target;
+	size_t region_size; // Bytes per frame.
+	int frame;          // Region written this frame.
+	size_t head;        // Next free byte inside the current region.
+	GLsync fences[STREAM_FRAMES];
+	char *persistent;   // Base of the persistent mapping, NULL when ARB_buffer_storage is missing.
+	char *mapped;       // Pointer returned by the last stream_buffer_map() when not persistent.
+	int stalls;         // Frames that had to wait for the GPU.
+} StreamBuffer;
+
+StreamBuffer stream_buffer_create(GLenum target, size_t region_size);
+void stream_buffer_begin_frame(StreamBuffer *stream);
+void stream_buffer_end_frame(StreamBuffer *stream);
+void *stream_buffer_map(StreamBuffer *stream, size_t size, size_t alignment, size_t *offset);
+void stream_buffer_unmap(StreamBuffer *stream);
+size_t stream_buffer_write(StreamBuffer *stream, const void *data, size_t size, size_t alignment);
+void stream_buffer_destroy(StreamBuffer *stream);
+
+#endif
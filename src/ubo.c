@@ -0,0 +1,83 @@
+#include <glad/glad.h>
+#include <string.h>
+#include "ubo.h"
+
+UboSystem ubo_create(int max_draws_per_frame) {
+	UboSystem ubo = {0};
+
+	// Each draw's range has to start at a multiple of the offset alignment.
+	GLint alignment;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	ubo.draw_stride = (sizeof(DrawUniforms) + alignment - 1) / alignment * alignment;
+
+	glGenBuffers(1, &ubo.frame_buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, ubo.frame_buffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), NULL, GL_DYNAMIC_DRAW);
+
+	ubo.draw_stream = stream_buffer_create(GL_UNIFORM_BUFFER, max_draws_per_frame * ubo.draw_stride);
+	return ubo;
+}
+
+// Point a program's Frame and Draw blocks at the shared binding points, checking
+// them against the C structs. Once after link.
+int ubo_bind_program(const ShaderProgram *program) {
+	if (!shader_check_block(program, "Frame", sizeof(FrameUniforms)) ||
+		!shader_check_block(program, "Draw", sizeof(DrawUniforms))) {
+		return 0;
+	}
+
+	const ShaderBlock *frame = shader_find_block(program, "Frame");
+	const ShaderBlock *draw = shader_find_block(program, "Draw");
+	if (frame) {
+		glUniformBlockBinding(program->id, frame->index, UBO_BINDING_FRAME);
+	}
+	if (draw) {
+		glUniformBlockBinding(program->id, draw->index, UBO_BINDING_DRAW);
+	}
+	return 1;
+}
+
+// Upload the frame constants and bind them for every program at once.
+void ubo_begin_frame(UboSystem *ubo, const FrameUniforms *frame) {
+	stream_buffer_begin_frame(&ubo->draw_stream);
+
+	glBindBuffer(GL_UNIFORM_BUFFER, ubo->frame_buffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), frame, GL_DYNAMIC_DRAW); // Orphan.
+	glBindBufferBase(GL_UNIFORM_BUFFER, UBO_BINDING_FRAME, ubo->frame_buffer);
+}
+
+// Upload the constants of `count` draws in one write. Returns the base offset to
+// pass to ubo_bind_draw(), or (size_t)-1 if the frame's ring region is full.
+size_t ubo_push_draws(UboSystem *ubo, const DrawUniforms *draws, int count) {
+	size_t base;
+	char *dest = stream_buffer_map(&ubo->draw_stream, count * ubo->draw_stride, ubo->draw_stride, &base);
+	if (!dest) {
+		return (size_t)-1;
+	}
+
+	for (int i = 0; i < count; i++) {
+		memcpy(dest + i * ubo->draw_stride, &draws[i], sizeof(DrawUniforms));
+	}
+	stream_buffer_unmap(&ubo->draw_stream);
+	return base;
+}
+
+// Byte offset in the ring of draw `index` of a ubo_push_draws() batch.
+size_t ubo_draw_offset(const UboSystem *ubo, size_t base, int index) {
+	return base + index * ubo->draw_stride;
+}
+
+void ubo_bind_draw(const UboSystem *ubo, size_t base, int index) {
+	glBindBufferRange(GL_UNIFORM_BUFFER, UBO_BINDING_DRAW, ubo->draw_stream.buffer,
+		ubo_draw_offset(ubo, base, index), sizeof(DrawUniforms));
+}
+
+void ubo_end_frame(UboSystem *ubo) {
+	stream_buffer_end_frame(&ubo->draw_stream);
+}
+
+void ubo_destroy(UboSystem *ubo) {
+	glDeleteBuffers(1, &ubo->frame_buffer);
+	stream_buffer_destroy(&ubo->draw_stream);
+	memset(ubo, 0, sizeof(*ubo));
+}
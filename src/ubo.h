@@ -0,0 +1,46 @@
+#ifndef UBO_H
+#define UBO_H
+
+#include <cglm/cglm.h>
+#include "stream.h"
+#include "shader.h"
+
+// Uniform block binding points shared by every program.
+#define UBO_BINDING_FRAME 0
+#define UBO_BINDING_DRAW 1
+#define UBO_BINDING_CLUSTERS 2
+#define UBO_BINDING_SHADOWS 3
+
+// std140 "Frame" block, uploaded and bound once per frame.
+typedef struct {
+	mat4 view;
+	mat4 proj;
+	mat4 view_proj;
+	mat4 inv_view_proj; // Rebuilds world positions from depth.
+	vec4 cam_pos; // w unused.
+} FrameUniforms;
+
+// std140 "Draw" block, one per draw call.
+typedef struct {
+	mat4 model;
+	vec4 color; // Albedo, specular strength in alpha.
+} DrawUniforms;
+
+typedef struct {
+	unsigned int frame_buffer;
+	StreamBuffer draw_stream; // Per draw constants, suballocated every frame.
+	size_t draw_stride;       // sizeof(DrawUniforms) rounded up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT.
+} UboSystem;
+
+UboSystem ubo_create(int max_draws_per_frame);
+// This and the other *_bind_program() functions run once after a program links,
+// from the shader manager's ready check, so nothing is bound by name while drawing.
+int ubo_bind_program(const ShaderProgram *program);
+void ubo_begin_frame(UboSystem *ubo, const FrameUniforms *frame);
+size_t ubo_push_draws(UboSystem *ubo, const DrawUniforms *draws, int count);
+size_t ubo_draw_offset(const UboSystem *ubo, size_t base, int index);
+void ubo_bind_draw(const UboSystem *ubo, size_t base, int index);
+void ubo_end_frame(UboSystem *ubo);
+void ubo_destroy(UboSystem *ubo);
+
+#endif